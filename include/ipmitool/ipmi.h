@@ -150,7 +150,7 @@ struct ipmi_rq_entry {
 	uint8_t *msg_data;
 	int msg_len;
 	int bridging_level;
-	struct ipmi_rq_entry *next;
+	int busy;
 };
 
 struct ipmi_rs {
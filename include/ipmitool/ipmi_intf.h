@@ -38,6 +38,7 @@
 #include <ipmitool/ipmi_constants.h>
 
 #include <sys/types.h>
+#include <sys/time.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -106,10 +107,33 @@ struct ipmi_session_params {
 	int port;
 	int retry;
 	uint32_t timeout;
+	int window;
 	uint8_t kg[IPMI_KG_BUFFER_SIZE];   /* BMC key */
 	uint8_t lookupbit;
+	char * session_dir;                /* lanplus sessions kept for reuse */
 };
 
+/*
+ * Outstanding requests of a LAN session, indexed by the 6-bit rq_seq of
+ * the IPMI message.  Packet buffers are allocated once with the table,
+ * only requests that do not fit get a buffer of their own.
+ */
+#define IPMI_RQ_TABLE_SIZE	64
+#define IPMI_RQ_MSG_SIZE	IPMI_BUF_SIZE
+
+struct ipmi_rq_table {
+	struct ipmi_rq_entry entry[IPMI_RQ_TABLE_SIZE];
+	uint8_t msg[IPMI_RQ_TABLE_SIZE][IPMI_RQ_MSG_SIZE];
+};
+
+/*
+ * Bounds of the adaptive retransmission timeout of LAN sessions, in
+ * milliseconds.  The timeout never drops below IPMI_RTO_MIN and backs
+ * off up to IPMI_RTO_MAX, or the session timeout if that is longer.
+ */
+#define IPMI_RTO_MIN	100
+#define IPMI_RTO_MAX	8000
+
 #define IPMI_AUTHSTATUS_PER_MSG_DISABLED	0x10
 #define IPMI_AUTHSTATUS_PER_USER_DISABLED	0x08
 #define IPMI_AUTHSTATUS_NONNULL_USERS_ENABLED	0x04
@@ -129,9 +153,23 @@ struct ipmi_session {
 	uint8_t authextra;
 	uint32_t timeout;
 
+	/*
+	 * Round trip time estimator of the session, all in milliseconds.
+	 * rto is 0 until the first reply has been timed; wait is how long
+	 * the receive path blocks for a packet, 0 meaning the session timeout.
+	 */
+	struct {
+		uint32_t srtt;
+		uint32_t rttvar;
+		uint32_t rto;
+		uint32_t wait;
+	} rtt;
+
 	struct sockaddr_storage addr;
 	socklen_t addrlen;
 
+	struct ipmi_rq_table * rq_table;
+
 	/*
 	 * This struct holds state data specific to IPMI v2 / RMCP+ sessions
 	 */
@@ -170,6 +208,15 @@ struct ipmi_session {
 		uint8_t k1_len;                    /* K1 key length */
 		uint8_t  k2[IPMI_MAX_MD_SIZE];      /* First 16 bytes used for AES  */
 		uint8_t k2_len;                    /* K2 key length */
+
+		/* Crypto contexts keyed once with K1/K2 and reused per packet */
+		void *k1_hmac_ctx;                 /* integrity HMAC */
+		void *k2_encrypt_ctx;              /* AES-CBC-128 encryption */
+		void *k2_decrypt_ctx;              /* AES-CBC-128 decryption */
+
+		/* Session kept in ssn_params.session_dir for later invocations */
+		int resume_fd;                     /* locked state file, -1 if none */
+		time_t last_rx;                    /* last authenticated response */
 	} v2_data;
 
 
@@ -233,6 +280,8 @@ struct ipmi_intf {
 	int (*open)(struct ipmi_intf * intf);
 	void (*close)(struct ipmi_intf * intf);
 	struct ipmi_rs *(*sendrecv)(struct ipmi_intf * intf, struct ipmi_rq * req);
+	int (*sendrecv_multi)(struct ipmi_intf * intf, struct ipmi_rq * req,
+	                      struct ipmi_rs * rsp, int count);
 	struct ipmi_rs *(*recv_sol)(struct ipmi_intf * intf);
 	struct ipmi_rs *(*send_sol)(struct ipmi_intf * intf, struct ipmi_v2_payload * payload);
 	int (*keepalive)(struct ipmi_intf * intf);
@@ -243,6 +292,8 @@ struct ipmi_intf {
 
 uint16_t ipmi_intf_get_max_request_data_size(struct ipmi_intf *intf);
 uint16_t ipmi_intf_get_max_response_data_size(struct ipmi_intf *intf);
+int ipmi_intf_sendrecv_multi(struct ipmi_intf *intf, struct ipmi_rq *req,
+                             struct ipmi_rs *rsp, int count);
 
 struct ipmi_intf * ipmi_intf_load(char * name);
 void ipmi_intf_print(struct ipmi_intf_support * intflist);
@@ -262,9 +313,28 @@ void ipmi_intf_session_set_port(struct ipmi_intf * intf, int port);
 void ipmi_intf_session_set_authtype(struct ipmi_intf * intf, uint8_t authtype);
 void ipmi_intf_session_set_timeout(struct ipmi_intf * intf, uint32_t timeout);
 void ipmi_intf_session_set_retry(struct ipmi_intf * intf, int retry);
+void ipmi_intf_session_set_window(struct ipmi_intf * intf, int window);
+void ipmi_intf_session_set_dir(struct ipmi_intf * intf, char * dir);
 void ipmi_intf_session_cleanup(struct ipmi_intf *intf);
 void ipmi_cleanup(struct ipmi_intf * intf);
 
+struct ipmi_rq_entry * ipmi_req_add_entry(struct ipmi_intf * intf,
+                                          struct ipmi_rq * req,
+                                          uint8_t req_seq);
+struct ipmi_rq_entry * ipmi_req_lookup_entry(struct ipmi_intf * intf,
+                                             uint8_t seq, uint8_t cmd);
+void ipmi_req_remove_entry(struct ipmi_intf * intf, uint8_t seq, uint8_t cmd);
+void ipmi_req_rekey_entry(struct ipmi_intf * intf,
+                          struct ipmi_rq_entry * entry, uint8_t seq);
+void ipmi_req_clear_entries(struct ipmi_intf * intf);
+uint8_t * ipmi_req_alloc_msg(struct ipmi_intf * intf,
+                             struct ipmi_rq_entry * entry, int len);
+
+uint64_t ipmi_intf_msec(void);
+uint32_t ipmi_intf_rto(struct ipmi_intf * intf, int try);
+void ipmi_intf_rtt_update(struct ipmi_intf * intf, uint32_t rtt);
+void ipmi_intf_rtt_timeval(struct ipmi_intf * intf, struct timeval * tv);
+
 #if defined(IPMI_INTF_LAN) || defined (IPMI_INTF_LANPLUS)
 int  ipmi_intf_socket_connect(struct ipmi_intf * intf);
 #endif
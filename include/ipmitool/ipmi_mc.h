@@ -213,6 +213,8 @@ typedef struct {
 parsed_guid_t ipmi_parse_guid(void *guid, ipmi_guid_mode_t guid_mode);
 
 int _ipmi_mc_get_guid(struct ipmi_intf *intf, ipmi_guid_t *guid);
+int ipmi_mc_get_identity(struct ipmi_intf *intf, char *name, size_t len,
+			 uint8_t *support);
 
 #ifdef HAVE_PRAGMA_PACK
 #pragma pack(1)
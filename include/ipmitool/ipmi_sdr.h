@@ -771,6 +771,17 @@ struct ipmi_sdr_iterator {
 	int use_built_in;
 };
 
+/* indexes kept over the global SDR list */
+enum {
+	SDR_INDEX_NUM,		/* sensor owner ID and number */
+	SDR_INDEX_ID,		/* ID string */
+	SDR_INDEX_ENTITY,	/* entity ID */
+	SDR_INDEX_MAX
+};
+
+/* per-sensor reading conversion tables, private to ipmi_sdr.c */
+struct sdr_conv_table;
+
 #ifdef HAVE_PRAGMA_PACK
 #pragma pack(1)
 #endif
@@ -792,6 +803,10 @@ struct sdr_record_list {
 		struct sdr_record_entity_assoc *entassoc;
 		struct sdr_record_oem *oem;
 	} ATTRIBUTE_PACKING  record;
+	/* hash chains of the global SDR list indexes */
+	struct sdr_record_list *hash_next[SDR_INDEX_MAX];
+	/* conversion tables of a full sensor, built on demand */
+	struct sdr_conv_table *conv;
 } ATTRIBUTE_PACKING;
 #ifdef HAVE_PRAGMA_PACK
 #pragma pack(0)
@@ -813,8 +828,15 @@ struct sensor_reading {
 	double		s_a_val;		/* read value converted to analog */
 	char		s_a_str[16];		/* analog value as a string */
 	const char	*s_a_units;		/* analog value units string */
+	int8_t		s_thresh_state;		/* 1 fetched, -1 no answer */
+	uint8_t		s_thresh_ccode;		/* thresholds completion code */
+	uint8_t		s_thresh_len;		/* thresholds data length */
+	uint8_t		s_thresh[7];		/* Get Sensor Thresholds data */
 };
 
+/* ipmi_sdr_read_sensors() flags */
+#define SDR_READ_THRESHOLDS	0x01
+
 /*
  * Determine if bridging is necessary to address a sensor at the given
  * address (_addr) and (_chan) via the interface (_intf).
@@ -863,6 +885,10 @@ struct sensor_reading *
 ipmi_sdr_read_sensor_value(struct ipmi_intf *intf,
 		struct sdr_record_common_sensor *sensor,
 		uint8_t sdr_record_type, int precision);
+struct sensor_reading *
+ipmi_sdr_read_sensors(struct ipmi_intf *intf, struct sdr_record_list **sensors,
+		int *count, int flags, int precision);
+void ipmi_sdr_set_readings(struct sensor_reading *sr, int count);
 const char *ipmi_sdr_get_thresh_status(struct sensor_reading *sr,
 					const char *invalidstr);
 const char *ipmi_sdr_get_status(int, const char *, uint8_t stat);
@@ -904,10 +930,15 @@ struct sdr_record_list *ipmi_sdr_find_sdr_bysensortype(struct ipmi_intf *intf,
 						       uint8_t type);
 struct sdr_record_list *ipmi_sdr_find_sdr_byid(struct ipmi_intf *intf,
 					       char *id);
+int ipmi_sdr_get_id_string(struct sdr_record_list *entry, char *buf,
+			   size_t len);
 struct sdr_record_list *ipmi_sdr_find_sdr_bytype(struct ipmi_intf *intf,
 						 uint8_t type);
 int ipmi_sdr_list_cache(struct ipmi_intf *intf);
 int ipmi_sdr_list_cache_fromfile(const char *ifile);
+void ipmi_sdr_set_cache_dir(const char *dir);
+int ipmi_sdr_get_info(struct ipmi_intf *intf,
+		      struct get_sdr_repository_info_rsp *sdr_repository_info);
 void ipmi_sdr_list_empty(void);
 int ipmi_sdr_print_info(struct ipmi_intf *intf);
 void ipmi_sdr_print_discrete_state(struct ipmi_intf *intf,
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2026 The ipmitool project.  All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * Neither the name of the copyright holder, nor the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * THE COPYRIGHT HOLDER AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * THE COPYRIGHT HOLDER OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE,
+ * PROFIT OR DATA, OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL,
+ * INCIDENTAL OR PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE
+ * THEORY OF LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS
+ * SOFTWARE, EVEN IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGES.
+ */
+
+#ifndef IPMI_SERVE_H
+#define IPMI_SERVE_H
+
+#include <ipmitool/ipmi.h>
+
+/*
+ * 'ipmitool serve' protocol
+ *
+ * Every request and every response is a frame: a 4-byte length in
+ * network byte order followed by that many bytes of body.  A request
+ * body starts with one of the IPMI_SERVE_* operations below, a
+ * response body with one of the IPMI_SERVE_STATUS_* codes.  Requests
+ * on one connection are answered in order.  Text output is what the
+ * command line would print on stdout and stderr.
+ *
+ * IPMI_SERVE_RAW        netfn, cmd, request data
+ *                       -> completion code, response data
+ * IPMI_SERVE_COMMAND    command line, every argument ending in '\0'
+ *                       -> command output
+ * IPMI_SERVE_SENSORS    -> 'sensor list' output
+ * IPMI_SERVE_SEL_SINCE  cursor file ending in '\0'
+ *                       -> 'sel elist new <cursor>' output
+ * IPMI_SERVE_FRU        [fru id] -> 'fru print [id]' output
+ */
+#define IPMI_SERVE_RAW		0x01
+#define IPMI_SERVE_COMMAND	0x02
+#define IPMI_SERVE_SENSORS	0x03
+#define IPMI_SERVE_SEL_SINCE	0x04
+#define IPMI_SERVE_FRU		0x05
+
+#define IPMI_SERVE_STATUS_OK		0x00	/* command succeeded */
+#define IPMI_SERVE_STATUS_FAILED	0x01	/* command failed, output follows */
+#define IPMI_SERVE_STATUS_NO_RESPONSE	0x02	/* BMC did not answer */
+#define IPMI_SERVE_STATUS_BAD_REQUEST	0x03	/* message follows */
+
+/* Largest request body accepted */
+#define IPMI_SERVE_REQUEST_MAX	4096
+
+/* Connections served at the same time */
+#define IPMI_SERVE_CLIENTS_MAX	64
+
+/* Idle seconds before the session is kept alive */
+#define IPMI_SERVE_KEEPALIVE	30
+
+/* Seconds 'fru' output is answered from memory */
+#define IPMI_SERVE_FRU_TTL	600
+
+int ipmi_serve_main(struct ipmi_intf * intf, int argc, char ** argv);
+
+#endif /* IPMI_SERVE_H */
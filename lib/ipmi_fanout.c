@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2026 The ipmitool project.  All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * Neither the name of the copyright holder, nor the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * THE COPYRIGHT HOLDER AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * THE COPYRIGHT HOLDER OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE,
+ * PROFIT OR DATA, OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL,
+ * INCIDENTAL OR PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE
+ * THEORY OF LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS
+ * SOFTWARE, EVEN IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGES.
+ */
+
+/*
+ * Multi-host fan-out: run the same command against every host listed
+ * in a host file, a bounded number of hosts at a time.
+ *
+ * Every host is served by a forked copy of ipmitool which continues
+ * through ipmi_main() exactly as a single-host invocation would, so each
+ * one gets its own interface and session state.  The parent does not
+ * talk to any BMC; it only multiplexes the workers' stdout and stderr
+ * in one poll() loop and streams their output line by line, prefixed
+ * with the host name, as soon as it arrives.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <ipmitool/helper.h>
+#include <ipmitool/log.h>
+#include <ipmitool/ipmi_fanout.h>
+
+struct fanout_worker {
+	pid_t pid;
+	const char * host;
+	int fd[2];	/* stdout and stderr of the worker, -1 once closed */
+	char line[2][IPMI_FANOUT_LINE_SIZE];
+	int len[2];
+};
+
+/* fanout_read_hostfile  -  read host names, one per line
+ *
+ * Empty lines and lines starting with '#' are skipped.
+ *
+ * @file:	host file name
+ * @hosts:	filled with malloc'ed array of malloc'ed names
+ *
+ * returns number of hosts read
+ * returns -1 on error
+ */
+static int
+fanout_read_hostfile(const char * file, char *** hosts)
+{
+	FILE * fp;
+	char buf[256];
+	char ** list = NULL;
+	int count = 0;
+	int size = 0;
+
+	fp = ipmi_open_file_read(file);
+	if (!fp)
+		return -1;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		char * name = buf;
+		char * end;
+
+		while (isspace((int)*name))
+			name++;
+		if (*name == '\0' || *name == '#')
+			continue;
+		for (end = name; *end && !isspace((int)*end); end++)
+			;
+		*end = '\0';
+
+		if (count == size) {
+			char ** tmp;
+
+			size = size ? size * 2 : 64;
+			tmp = realloc(list, size * sizeof(char *));
+			if (!tmp)
+				goto out_nomem;
+			list = tmp;
+		}
+		list[count] = strdup(name);
+		if (!list[count])
+			goto out_nomem;
+		count++;
+	}
+	fclose(fp);
+
+	*hosts = list;
+	return count;
+
+out_nomem:
+	lprintf(LOG_ERR, "ipmitool: malloc failure");
+	fclose(fp);
+	while (count > 0)
+		free(list[--count]);
+	free(list);
+	return -1;
+}
+
+/* fanout_emit  -  print buffered worker output tagged with its host
+ *
+ * @w:		worker
+ * @i:		0 for stdout, 1 for stderr
+ * @all:	print trailing partial line too
+ */
+static void
+fanout_emit(struct fanout_worker * w, int i, int all)
+{
+	FILE * out = i ? stderr : stdout;
+	char * start = w->line[i];
+	char * nl;
+	int left = w->len[i];
+
+	while (left > 0 && (nl = memchr(start, '\n', left))) {
+		fprintf(out, "%s: %.*s\n", w->host, (int)(nl - start), start);
+		left -= nl - start + 1;
+		start = nl + 1;
+	}
+
+	/* a line which does not fit the buffer is passed on in pieces */
+	if (left > 0 && (all || left == IPMI_FANOUT_LINE_SIZE)) {
+		fprintf(out, "%s: %.*s\n", w->host, left, start);
+		left = 0;
+	}
+
+	memmove(w->line[i], start, left);
+	w->len[i] = left;
+	fflush(out);
+}
+
+/* fanout_spawn  -  start a worker for one host
+ *
+ * @w:		worker slot to use
+ * @host:	host name
+ *
+ * returns 0 in the parent
+ * returns 1 in the worker, its stdout and stderr are redirected
+ * returns -1 on error
+ */
+static int
+fanout_spawn(struct fanout_worker * w, const char * host)
+{
+	int out[2], err[2];
+
+	if (pipe(out) < 0) {
+		lperror(LOG_ERR, "pipe");
+		return -1;
+	}
+	if (pipe(err) < 0) {
+		lperror(LOG_ERR, "pipe");
+		close(out[0]);
+		close(out[1]);
+		return -1;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	w->pid = fork();
+	if (w->pid < 0) {
+		lperror(LOG_ERR, "fork");
+		close(out[0]);
+		close(out[1]);
+		close(err[0]);
+		close(err[1]);
+		return -1;
+	}
+
+	if (w->pid == 0) {
+		close(out[0]);
+		close(err[0]);
+		dup2(out[1], STDOUT_FILENO);
+		dup2(err[1], STDERR_FILENO);
+		close(out[1]);
+		close(err[1]);
+		setvbuf(stdout, NULL, _IOLBF, 0);
+		return 1;
+	}
+
+	close(out[1]);
+	close(err[1]);
+	w->host = host;
+	w->fd[0] = out[0];
+	w->fd[1] = err[0];
+	w->len[0] = w->len[1] = 0;
+	return 0;
+}
+
+/* fanout_reap  -  collect a worker whose output is closed
+ *
+ * @w:		worker
+ *
+ * returns exit status of the worker, -1 if it did not exit normally
+ */
+static int
+fanout_reap(struct fanout_worker * w)
+{
+	int status;
+
+	while (waitpid(w->pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			lperror(LOG_ERR, "waitpid");
+			return -1;
+		}
+	}
+	w->pid = 0;
+
+	if (!WIFEXITED(status))
+		return -1;
+	return WEXITSTATUS(status);
+}
+
+/* ipmi_fanout_run  -  run the command line against every host of a file
+ *
+ * Returns in the parent once all hosts are done.  Also returns, with
+ * @host set, in every worker; the caller is expected to carry on with
+ * a normal single-host run against it and exit.
+ *
+ * @hostfile:	file with one host name per line
+ * @fanout:	maximum number of hosts driven at the same time
+ * @host:	set to malloc'ed host name in the worker, NULL in the parent
+ *
+ * returns 0 if the command succeeded on all hosts
+ * returns -1 otherwise
+ */
+int
+ipmi_fanout_run(const char * hostfile, int fanout, char ** host)
+{
+	struct fanout_worker * workers = NULL;
+	struct fanout_worker ** owner = NULL;
+	struct pollfd * pfd = NULL;
+	char ** hosts = NULL;
+	int nhosts, next = 0, running = 0, failed = 0;
+	int rc = -1;
+	int i, j, n;
+
+	*host = NULL;
+
+	nhosts = fanout_read_hostfile(hostfile, &hosts);
+	if (nhosts < 0)
+		return -1;
+	if (nhosts == 0) {
+		lprintf(LOG_ERR, "No hosts found in %s", hostfile);
+		goto out_free;
+	}
+
+	if (fanout > nhosts)
+		fanout = nhosts;
+
+	workers = calloc(fanout, sizeof(struct fanout_worker));
+	owner = calloc(2 * fanout, sizeof(struct fanout_worker *));
+	pfd = calloc(2 * fanout, sizeof(struct pollfd));
+	if (!workers || !owner || !pfd) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		goto out_free;
+	}
+
+	lprintf(LOG_INFO, "Running on %d hosts, %d at a time", nhosts, fanout);
+
+	for (;;) {
+		/* keep every worker slot busy while there are hosts left */
+		for (i = 0; i < fanout && next < nhosts; i++) {
+			if (workers[i].pid)
+				continue;
+
+			switch (fanout_spawn(&workers[i], hosts[next])) {
+			case 1:
+				/* worker: leave nothing of the parent behind */
+				for (j = 0; j < fanout; j++) {
+					if (!workers[j].pid || j == i)
+						continue;
+					close(workers[j].fd[0]);
+					close(workers[j].fd[1]);
+				}
+				*host = strdup(hosts[next]);
+				if (!*host) {
+					lprintf(LOG_ERR, "ipmitool: malloc failure");
+					rc = -1;
+				} else {
+					rc = 0;
+				}
+				goto out_free;
+			case 0:
+				running++;
+				break;
+			default:
+				failed++;
+				break;
+			}
+			next++;
+		}
+
+		if (!running)
+			break;
+
+		n = 0;
+		for (i = 0; i < fanout; i++) {
+			for (j = 0; j < 2; j++) {
+				if (!workers[i].pid || workers[i].fd[j] < 0)
+					continue;
+				pfd[n].fd = workers[i].fd[j];
+				pfd[n].events = POLLIN;
+				pfd[n].revents = 0;
+				owner[n] = &workers[i];
+				n++;
+			}
+		}
+
+		if (poll(pfd, n, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			lperror(LOG_ERR, "poll");
+			goto out_free;
+		}
+
+		for (i = 0; i < n; i++) {
+			struct fanout_worker * w = owner[i];
+			ssize_t r;
+
+			if (!pfd[i].revents)
+				continue;
+
+			j = (pfd[i].fd == w->fd[0]) ? 0 : 1;
+			r = read(w->fd[j], w->line[j] + w->len[j],
+				 IPMI_FANOUT_LINE_SIZE - w->len[j]);
+			if (r < 0 && errno == EINTR)
+				continue;
+			if (r > 0) {
+				w->len[j] += r;
+				fanout_emit(w, j, 0);
+				continue;
+			}
+
+			/* end of output from this stream */
+			fanout_emit(w, j, 1);
+			close(w->fd[j]);
+			w->fd[j] = -1;
+			if (w->fd[0] >= 0 || w->fd[1] >= 0)
+				continue;
+
+			r = fanout_reap(w);
+			lprintf(LOG_INFO, "%s: exit status %d", w->host, (int)r);
+			if (r != 0)
+				failed++;
+			running--;
+		}
+	}
+
+	if (failed)
+		lprintf(LOG_NOTICE, "Command failed on %d of %d hosts",
+			failed, nhosts);
+	else
+		rc = 0;
+
+out_free:
+	for (i = 0; i < nhosts; i++)
+		free(hosts[i]);
+	free(hosts);
+	free(workers);
+	free(owner);
+	free(pfd);
+	return rc;
+}
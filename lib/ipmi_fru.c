@@ -647,6 +647,81 @@ write_fru_area(struct ipmi_intf * intf, struct fru_info *fru, uint8_t id,
 	return doffset >= finish;
 }
 
+/* read_fru_area_multi  -  read FRU[offset:finish] as one batch of requests
+*
+* Issues all Read FRU Data requests at once so a pipelined interface can
+* keep them in flight together.
+*
+* @intf:   ipmi interface
+* @fru:    fru info
+* @id:     fru id
+* @offset: offset to start reading at
+* @finish: offset to stop reading at
+* @frubuf: buffer read into
+*
+* returns number of leading bytes that were read successfully
+*/
+static uint32_t
+read_fru_area_multi(struct ipmi_intf * intf, struct fru_info *fru, uint8_t id,
+			uint32_t offset, uint32_t finish, uint8_t *frubuf)
+{
+	struct ipmi_rq * reqs;
+	struct ipmi_rs * rsps;
+	uint8_t * msg_data;
+	uint32_t off, tmp, read = 0;
+	int n, k;
+
+	n = (finish - offset + fru->max_read_size - 1) / fru->max_read_size;
+
+	reqs = malloc(n * sizeof(struct ipmi_rq));
+	rsps = malloc(n * sizeof(struct ipmi_rs));
+	msg_data = malloc(n * 4);
+	if (!reqs || !rsps || !msg_data) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		goto out;
+	}
+
+	for (k = 0; k < n; k++) {
+		off = offset + k * fru->max_read_size;
+		tmp = fru->access ? off >> 1 : off;
+		msg_data[4 * k] = id;
+		msg_data[4 * k + 1] = (uint8_t)(tmp & 0xff);
+		msg_data[4 * k + 2] = (uint8_t)(tmp >> 8);
+		msg_data[4 * k + 3] = (uint8_t)__min(finish - off,
+						     fru->max_read_size);
+
+		memset(&reqs[k], 0, sizeof(struct ipmi_rq));
+		reqs[k].msg.netfn = IPMI_NETFN_STORAGE;
+		reqs[k].msg.cmd = GET_FRU_DATA;
+		reqs[k].msg.data = &msg_data[4 * k];
+		reqs[k].msg.data_len = 4;
+	}
+
+	if (ipmi_intf_sendrecv_multi(intf, reqs, rsps, n) < 0)
+		goto out;
+
+	/* stop at the first read that needs the careful path */
+	for (k = 0; k < n; k++) {
+		if (rsps[k].data_len < 1 || rsps[k].ccode)
+			break;
+		tmp = fru->access ? rsps[k].data[0] << 1 : rsps[k].data[0];
+		if (tmp > (uint32_t)(rsps[k].data_len - 1))
+			break;
+		if (tmp > msg_data[4 * k + 3])
+			tmp = msg_data[4 * k + 3];
+		memcpy(frubuf + read, rsps[k].data + 1, tmp);
+		read += tmp;
+		if (tmp < msg_data[4 * k + 3])
+			break;
+	}
+
+out:
+	free(reqs);
+	free(rsps);
+	free(msg_data);
+	return read;
+}
+
 /* read_fru_area  -  fill in frubuf[offset:length] from the FRU[offset:length]
 *
 * @intf:   ipmi interface
@@ -721,6 +796,19 @@ read_fru_area(struct ipmi_intf * intf, struct fru_info *fru, uint8_t id,
 	}
 
 	size_left_in_buffer = length;
+
+	/* with a pipelined interface fetch the whole area at once,
+	 * the loop below picks up wherever that stopped
+	 */
+	if (intf->ssn_params.window > 1 && length > fru->max_read_size) {
+		tmp = read_fru_area_multi(intf, fru, id, off, finish, frubuf);
+		off += tmp;
+		frubuf += tmp;
+		size_left_in_buffer -= tmp;
+		if (off >= finish)
+			return 0;
+	}
+
 	do {
 		tmp = fru->access ? off >> 1 : off;
 		msg_data[0] = id;
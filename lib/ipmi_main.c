@@ -73,13 +73,14 @@
 #include <ipmitool/ipmi_kontronoem.h>
 #include <ipmitool/ipmi_vita.h>
 #include <ipmitool/ipmi_quantaoem.h>
+#include <ipmitool/ipmi_fanout.h>
 
 #ifdef HAVE_CONFIG_H
 # include <config.h>
 #endif
 
 #ifdef ENABLE_ALL_OPTIONS
-# define OPTION_STRING	"I:46hVvcgsEKYao:H:d:P:f:U:p:C:L:A:t:T:m:z:S:l:b:B:e:k:y:O:R:N:D:Z"
+# define OPTION_STRING	"I:46hVvcgsEKYao:H:d:P:f:U:p:C:L:A:t:T:m:z:S:l:b:B:e:k:y:O:R:N:W:F:J:D:Z"
 #else
 # define OPTION_STRING	"I:46hVvcH:f:U:p:d:S:D:"
 #endif
@@ -227,6 +228,7 @@ ipmi_option_usage(const char * progname, struct ipmi_cmd * cmdlist, struct ipmi_
 	lprintf(LOG_NOTICE, "       -d N           Specify a /dev/ipmiN device to use (default=0)");
 	lprintf(LOG_NOTICE, "       -I intf        Interface to use");
 	lprintf(LOG_NOTICE, "       -H hostname    Remote host name for LAN interface");
+	lprintf(LOG_NOTICE, "                      Use @file to run the command on every host listed in file");
 	lprintf(LOG_NOTICE, "       -p port        Remote RMCP port [default=623]");
 	lprintf(LOG_NOTICE, "       -U username    Remote session username");
 	lprintf(LOG_NOTICE, "       -f file        Read remote session password from file");
@@ -259,6 +261,9 @@ ipmi_option_usage(const char * progname, struct ipmi_cmd * cmdlist, struct ipmi_
 	lprintf(LOG_NOTICE, "       -O seloem      Use file for OEM SEL event descriptions");
 	lprintf(LOG_NOTICE, "       -N seconds     Specify timeout for lan [default=2] / lanplus [default=1] interface");
 	lprintf(LOG_NOTICE, "       -R retry       Set the number of retries for lan/lanplus interface [default=4]");
+	lprintf(LOG_NOTICE, "       -W window      Number of requests kept in flight by lanplus interface [default=1]");
+	lprintf(LOG_NOTICE, "       -F fanout      Number of hosts from -H @file driven at the same time [default=16]");
+	lprintf(LOG_NOTICE, "       -J dir         Keep lanplus sessions in dir and resume them in later runs");
 	lprintf(LOG_NOTICE, "       -Z             Display all dates in UTC");
 #endif
 	lprintf(LOG_NOTICE, "");
@@ -330,6 +335,8 @@ ipmi_main(int argc, char ** argv,
 	uint8_t my_long_packet_set=0;
 	uint8_t lookupbit = 0x10;	/* use name-only lookup by default */
 	int retry = 0;
+	int window = 0;
+	int fanout = IPMI_FANOUT_DEFAULT;
 	uint32_t timeout = 0;
 	int authtype = -1;
 	char * tmp_pass = NULL;
@@ -341,6 +348,7 @@ ipmi_main(int argc, char ** argv,
 	char * progname = NULL;
 	char * oemtype  = NULL;
 	char * sdrcache = NULL;
+	char * sessiondir = NULL;
 	uint8_t kgkey[IPMI_KG_BUFFER_SIZE];
 	char * seloem   = NULL;
 	int port = 0;
@@ -768,6 +776,32 @@ ipmi_main(int argc, char ** argv,
 				goto out_free;
 			}
 			break;
+		case 'W':
+			if (str2int(optarg, &window) != 0 || window < 1) {
+				lprintf(LOG_ERR, "Invalid parameter given or out of range for '-W'.");
+				rc = -1;
+				goto out_free;
+			}
+			break;
+		case 'F':
+			if (str2int(optarg, &fanout) != 0
+			    || fanout < 1 || fanout > IPMI_FANOUT_MAX) {
+				lprintf(LOG_ERR, "Invalid parameter given or out of range for '-F'.");
+				rc = -1;
+				goto out_free;
+			}
+			break;
+		case 'J':
+			if (sessiondir) {
+				free(sessiondir);
+				sessiondir = NULL;
+			}
+			sessiondir = strdup(optarg);
+			if (!sessiondir) {
+				lprintf(LOG_ERR, "%s: malloc failure", progname);
+				goto out_free;
+			}
+			break;
 		case 'Z':
 			time_in_utc = 1;
 			break;
@@ -837,6 +871,24 @@ ipmi_main(int argc, char ** argv,
 		}
 	}
 
+	/*
+	 * A hostname of @file runs the command on all hosts listed in file.
+	 * Every host is handled by a worker which comes back here and goes
+	 * on as if the host had been given with -H, the parent returns once
+	 * all of them are done.
+	 */
+	if (hostname && hostname[0] == '@') {
+		char * host;
+
+		log_init(progname, 0, verbose);
+		rc = ipmi_fanout_run(hostname + 1, fanout, &host);
+		if (!host)
+			goto out_free;
+		free(hostname);
+		hostname = host;
+		rc = -1;
+	}
+
 	/* load interface */
 	ipmi_main_intf = ipmi_intf_load(intfname);
 	if (!ipmi_main_intf) {
@@ -882,6 +934,10 @@ ipmi_main(int argc, char ** argv,
 		ipmi_intf_session_set_retry(ipmi_main_intf, retry);
 	if (timeout > 0)
 		ipmi_intf_session_set_timeout(ipmi_main_intf, timeout);
+	if (window > 0)
+		ipmi_intf_session_set_window(ipmi_main_intf, window);
+	if (sessiondir)
+		ipmi_intf_session_set_dir(ipmi_main_intf, sessiondir);
 
 	ipmi_intf_session_set_lookupbit(ipmi_main_intf, lookupbit);
 	ipmi_intf_session_set_sol_escape_char(ipmi_main_intf, sol_escape_char);
@@ -991,9 +1047,14 @@ ipmi_main(int argc, char ** argv,
 			ipmi_main_intf->target_channel,
 			ipmi_main_intf->target_ipmb_addr);
 
-	/* parse local SDR cache if given */
+	/* parse local SDR cache if given, a directory holds automatic caches */
 	if (sdrcache) {
-		ipmi_sdr_list_cache_fromfile(sdrcache);
+		struct stat st;
+
+		if (stat(sdrcache, &st) == 0 && S_ISDIR(st.st_mode))
+			ipmi_sdr_set_cache_dir(sdrcache);
+		else
+			ipmi_sdr_list_cache_fromfile(sdrcache);
 	}
 	/* Parse SEL OEM file if given */
 	if (seloem) {
@@ -1067,6 +1128,10 @@ ipmi_main(int argc, char ** argv,
 		free(sdrcache);
 		sdrcache = NULL;
 	}
+	if (sessiondir) {
+		free(sessiondir);
+		sessiondir = NULL;
+	}
 	if (devfile) {
 		free(devfile);
 		devfile = NULL;
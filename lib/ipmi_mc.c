@@ -521,6 +521,67 @@ _ipmi_mc_get_guid(struct ipmi_intf *intf, ipmi_guid_t *guid)
 	return 0;
 }
 
+/* ipmi_mc_get_identity  -  build a name that identifies the BMC
+ *
+ * The name is made of manufacturer, product, device ID and device GUID,
+ * and is suitable as a file name for per-BMC state.
+ *
+ * @intf:	ipmi interface
+ * @name:	buffer for the name
+ * @len:	size of buffer
+ * @support:	filled with the Additional Device Support byte, may be NULL
+ *
+ * returns 0 on success
+ * returns -1 on error or if the BMC has no usable GUID
+ */
+int
+ipmi_mc_get_identity(struct ipmi_intf *intf, char *name, size_t len,
+		     uint8_t *support)
+{
+	struct ipmi_rs *rsp;
+	struct ipmi_rq req;
+	struct ipm_devid_rsp devid;
+	ipmi_guid_t guid;
+	uint8_t *g = (uint8_t *)&guid;
+	int i, n, zero = 0, ones = 0;
+
+	memset(&req, 0, sizeof (req));
+	req.msg.netfn = IPMI_NETFN_APP;
+	req.msg.cmd = BMC_GET_DEVICE_ID;
+
+	rsp = intf->sendrecv(intf, &req);
+	/* auxiliary firmware revision is optional */
+	if (!rsp || rsp->ccode
+	    || rsp->data_len < (int)(sizeof (devid) - sizeof (devid.aux_fw_rev)))
+		return -1;
+	memset(&devid, 0, sizeof (devid));
+	memcpy(&devid, rsp->data, __min(sizeof (devid), (size_t)rsp->data_len));
+
+	if (support)
+		*support = devid.adtl_device_support;
+
+	if (_ipmi_mc_get_guid(intf, &guid) != 0)
+		return -1;
+	for (i = 0; i < (int)sizeof (guid); i++) {
+		zero += (g[i] == 0x00);
+		ones += (g[i] == 0xff);
+	}
+	if (zero == sizeof (guid) || ones == sizeof (guid)) {
+		lprintf(LOG_DEBUG, "BMC reports no usable device GUID");
+		return -1;
+	}
+
+	n = snprintf(name, len, "%06lx-%04x-%02x-",
+		     (long)IPM_DEV_MANUFACTURER_ID(devid.manufacturer_id),
+		     buf2short(devid.product_id), devid.device_id);
+	for (i = 0; i < (int)sizeof (guid) && n > 0 && (size_t)n < len; i++)
+		n += snprintf(name + n, len - n, "%02x", g[i]);
+	if (n <= 0 || (size_t)n >= len)
+		return -1;
+
+	return 0;
+}
+
 /* A helper function to convert GUID time to time_t */
 static time_t _guid_time(uint64_t t_low, uint64_t t_mid, uint64_t t_hi)
 {
@@ -38,8 +38,12 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <time.h>
 
 #include <ipmitool/ipmi.h>
@@ -69,6 +73,57 @@ static struct sdr_record_list *sdr_list_head = NULL;
 static struct sdr_record_list *sdr_list_tail = NULL;
 static struct ipmi_sdr_iterator *sdr_list_itr = NULL;
 
+/* Hash indexes over the global SDR list.  Each bucket chain is kept in
+ * list order so a lookup returns the same record a linear scan would.
+ */
+#define SDR_HASH_SIZE	256
+
+struct sdr_hash_bucket {
+	struct sdr_record_list *head;
+	struct sdr_record_list **tail;
+};
+
+static struct sdr_hash_bucket sdr_hash[SDR_INDEX_MAX][SDR_HASH_SIZE];
+
+/* readings prefetched by ipmi_sdr_read_sensors() for the printers */
+static struct sensor_reading *sdr_readings = NULL;
+static int sdr_readings_count = 0;
+static int sdr_readings_next = 0;
+
+/* requests handed to the transport at once by ipmi_sdr_read_sensors() */
+#define SDR_READ_CHUNK	64
+
+/* mapped SDR cache file and the list entries pointing into it */
+static uint8_t *sdr_cache_map = NULL;
+static size_t sdr_cache_map_len = 0;
+static struct sdr_record_list *sdr_cache_nodes = NULL;
+static uint32_t sdr_cache_count = 0;
+
+static struct ipmi_sdr_iterator *__sdr_list_start(struct ipmi_intf *intf);
+static void __sdr_list_append(struct sdr_record_list *sdrr);
+static unsigned int __sdr_hash_num(uint8_t owner, uint8_t num);
+
+/* Conversion tables of a full sensor record, one entry per raw value.
+ * They are built on first use from the factors saved in the key and
+ * rebuilt when the record's factors change.
+ */
+enum {
+	SDR_CONV_READING,
+	SDR_CONV_HYSTERESIS,
+	SDR_CONV_TOLERANCE,
+	SDR_CONV_MAX
+};
+
+struct sdr_conv_table {
+	uint16_t mtol;			/* factors the tables were built from */
+	uint32_t bacc;
+	uint8_t analog;
+	uint8_t linearization;
+	double *value[SDR_CONV_MAX];	/* raw value -> converted value */
+	uint8_t *raw;			/* raw values ordered by reading */
+	int raw_count;			/* entries of raw, NaN readings left out */
+};
+
 /* IPMI 2.0 Table 43-15, Sensor Unit Type Codes */
 #define UNIT_TYPE_MAX 92 /* This is the ID of "grams" */
 #define UNIT_TYPE_LONGEST_NAME 19 /* This is the length of "color temp deg K" */
@@ -350,15 +405,15 @@ sdr_sensor_has_analog_reading(struct ipmi_intf *intf,
 	return 1;
 }
 
-/* sdr_convert_sensor_reading  -  convert raw sensor reading
+/* __sdr_calc_sensor_reading  -  compute converted sensor reading
  *
  * @sensor:	sensor record
  * @val:	raw sensor reading
  *
  * returns floating-point sensor reading
  */
-double
-sdr_convert_sensor_reading(struct sdr_record_full_sensor *sensor, uint8_t val)
+static double
+__sdr_calc_sensor_reading(struct sdr_record_full_sensor *sensor, uint8_t val)
 {
 	int m, b, k1, k2;
 	double result;
@@ -426,7 +481,7 @@ sdr_convert_sensor_reading(struct sdr_record_full_sensor *sensor, uint8_t val)
 	}
 	return result;
 }
-/* sdr_convert_sensor_hysterisis  -  convert raw sensor hysterisis
+/* __sdr_calc_sensor_hysterisis  -  compute converted sensor hysterisis
  *
  * Even though spec says histerisis should be computed using Mx+B
  * formula, B is irrelevant when doing raw comparison
@@ -439,8 +494,8 @@ sdr_convert_sensor_reading(struct sdr_record_full_sensor *sensor, uint8_t val)
  *
  * returns floating-point sensor reading
  */
-double
-sdr_convert_sensor_hysterisis(struct sdr_record_full_sensor *sensor, uint8_t val)
+static double
+__sdr_calc_sensor_hysterisis(struct sdr_record_full_sensor *sensor, uint8_t val)
 {
 	int m, k2;
 	double result;
@@ -507,15 +562,15 @@ sdr_convert_sensor_hysterisis(struct sdr_record_full_sensor *sensor, uint8_t val
 }
 
 
-/* sdr_convert_sensor_tolerance  -  convert raw sensor reading
+/* __sdr_calc_sensor_tolerance  -  compute converted sensor tolerance
  *
  * @sensor:	sensor record
  * @val:	raw sensor reading
  *
  * returns floating-point sensor tolerance(interpreted)
  */
-double
-sdr_convert_sensor_tolerance(struct sdr_record_full_sensor *sensor, uint8_t val)
+static double
+__sdr_calc_sensor_tolerance(struct sdr_record_full_sensor *sensor, uint8_t val)
 {
 	int m,   k2;
 	double result;
@@ -581,7 +636,230 @@ sdr_convert_sensor_tolerance(struct sdr_record_full_sensor *sensor, uint8_t val)
 	return result;
 }
 
+static double (* const sdr_conv_calc[SDR_CONV_MAX])
+	(struct sdr_record_full_sensor *sensor, uint8_t val) = {
+	__sdr_calc_sensor_reading,
+	__sdr_calc_sensor_hysterisis,
+	__sdr_calc_sensor_tolerance,
+};
+
+/* __sdr_conv_free  -  release conversion tables
+ *
+ * @t:		conversion tables, may be NULL
+ */
+static void
+__sdr_conv_free(struct sdr_conv_table *t)
+{
+	int i;
+
+	if (!t)
+		return;
+	for (i = 0; i < SDR_CONV_MAX; i++)
+		free(t->value[i]);
+	free(t->raw);
+	free(t);
+}
+
+/* __sdr_conv_table  -  conversion tables of a sensor in the SDR list
+ *
+ * Sensors whose factors the BMC hands out per reading are not
+ * tabulated.
+ *
+ * @sensor:	sensor record
+ *
+ * returns conversion tables matching the current factors
+ * returns NULL if the sensor has no tables
+ */
+static struct sdr_conv_table *
+__sdr_conv_table(struct sdr_record_full_sensor *sensor)
+{
+	struct sdr_record_list *e;
+	struct sdr_conv_table *t;
+	int i;
+
+	if ((sensor->linearization & 0x7f) >= SDR_SENSOR_L_NONLINEAR)
+		return NULL;
+
+	e = sdr_hash[SDR_INDEX_NUM][__sdr_hash_num(sensor->cmn.keys.owner_id,
+				   sensor->cmn.keys.sensor_num)].head;
+	for (; e; e = e->hash_next[SDR_INDEX_NUM]) {
+		if (e->record.full == sensor)
+			break;
+	}
+	if (!e)
+		return NULL;
+
+	t = e->conv;
+	if (!t) {
+		t = calloc(1, sizeof(*t));
+		if (!t)
+			return NULL;
+		e->conv = t;
+	} else if (t->mtol == sensor->mtol && t->bacc == sensor->bacc
+		   && t->analog == sensor->cmn.unit.analog
+		   && t->linearization == sensor->linearization) {
+		return t;
+	}
+
+	/* new record or changed factors */
+	for (i = 0; i < SDR_CONV_MAX; i++) {
+		free(t->value[i]);
+		t->value[i] = NULL;
+	}
+	free(t->raw);
+	t->raw = NULL;
+	t->raw_count = 0;
+	t->mtol = sensor->mtol;
+	t->bacc = sensor->bacc;
+	t->analog = sensor->cmn.unit.analog;
+	t->linearization = sensor->linearization;
+
+	return t;
+}
+
+/* __sdr_conv_values  -  converted values of a sensor by raw value
+ *
+ * @sensor:	sensor record
+ * @kind:	SDR_CONV_READING, SDR_CONV_HYSTERESIS or SDR_CONV_TOLERANCE
+ *
+ * returns table of 256 converted values
+ * returns NULL if the sensor has no tables
+ */
+static const double *
+__sdr_conv_values(struct sdr_record_full_sensor *sensor, int kind)
+{
+	struct sdr_conv_table *t;
+	double *v;
+	int i;
+
+	t = __sdr_conv_table(sensor);
+	if (!t)
+		return NULL;
+
+	if (!t->value[kind]) {
+		v = malloc(256 * sizeof(*v));
+		if (!v)
+			return NULL;
+		for (i = 0; i < 256; i++)
+			v[i] = sdr_conv_calc[kind](sensor, i);
+		t->value[kind] = v;
+	}
+
+	return t->value[kind];
+}
+
+/* __sdr_raw_order  -  order raw values by their reading
+ *
+ * @reading:	readings indexed by raw value
+ * @raw:	256 entries, filled with raw values by ascending reading
+ *
+ * returns number of raw values stored, readings that are NaN left out
+ */
+static int
+__sdr_raw_order(const double *reading, uint8_t *raw)
+{
+	int count = 0;
+	int i, j;
+
+	/* readings are monotonic for most sensors, so this is quick */
+	for (i = 0; i < 256; i++) {
+		if (isnan(reading[i]))
+			continue;
+		for (j = count; j > 0 && reading[raw[j - 1]] > reading[i]; j--)
+			raw[j] = raw[j - 1];
+		raw[j] = i;
+		count++;
+	}
+
+	return count;
+}
+
+/* __sdr_raw_nearest  -  raw value with the reading closest to a value
+ *
+ * Ties go to the larger reading.
+ *
+ * @reading:	readings indexed by raw value
+ * @raw:	raw values by ascending reading
+ * @count:	number of raw values
+ * @val:	converted value to look up
+ *
+ * returns raw value
+ */
+static uint8_t
+__sdr_raw_nearest(const double *reading, const uint8_t *raw, int count,
+		  double val)
+{
+	int lo = 0, hi = count, mid;
+
+	if (count == 0)
+		return 0;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (reading[raw[mid]] < val)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0)
+		return raw[0];
+	if (lo == count)
+		return raw[count - 1];
+	if (reading[raw[lo]] - val <= val - reading[raw[lo - 1]])
+		return raw[lo];
+	return raw[lo - 1];
+}
+
+/* sdr_convert_sensor_reading  -  convert raw sensor reading
+ *
+ * @sensor:	sensor record
+ * @val:	raw sensor reading
+ *
+ * returns floating-point sensor reading
+ */
+double
+sdr_convert_sensor_reading(struct sdr_record_full_sensor *sensor, uint8_t val)
+{
+	const double *v = __sdr_conv_values(sensor, SDR_CONV_READING);
+
+	return v ? v[val] : __sdr_calc_sensor_reading(sensor, val);
+}
+
+/* sdr_convert_sensor_hysterisis  -  convert raw sensor hysterisis
+ *
+ * @sensor:	sensor record
+ * @val:	raw sensor reading
+ *
+ * returns floating-point sensor reading
+ */
+double
+sdr_convert_sensor_hysterisis(struct sdr_record_full_sensor *sensor, uint8_t val)
+{
+	const double *v = __sdr_conv_values(sensor, SDR_CONV_HYSTERESIS);
+
+	return v ? v[val] : __sdr_calc_sensor_hysterisis(sensor, val);
+}
+
+/* sdr_convert_sensor_tolerance  -  convert raw sensor reading
+ *
+ * @sensor:	sensor record
+ * @val:	raw sensor reading
+ *
+ * returns floating-point sensor tolerance(interpreted)
+ */
+double
+sdr_convert_sensor_tolerance(struct sdr_record_full_sensor *sensor, uint8_t val)
+{
+	const double *v = __sdr_conv_values(sensor, SDR_CONV_TOLERANCE);
+
+	return v ? v[val] : __sdr_calc_sensor_tolerance(sensor, val);
+}
+
 /* sdr_convert_sensor_value_to_raw  -  convert sensor reading back to raw
+ *
+ * The raw value is looked up among the converted readings, so the
+ * sensor's linearization is honoured.
  *
  * @sensor:	sensor record
  * @val:	converted sensor reading
@@ -592,28 +870,36 @@ uint8_t
 sdr_convert_sensor_value_to_raw(struct sdr_record_full_sensor * sensor,
 				double val)
 {
-	int m, b, k1, k2;
-	double result;
+	struct sdr_conv_table *t;
+	const double *reading = NULL;
+	double tab[256];
+	uint8_t raw[256];
+	int count, i;
 
 	/* only works for analog sensors */
 	if (UNITS_ARE_DISCRETE((&sensor->cmn)))
 		return 0;
 
-	m = __TO_M(sensor->mtol);
-	b = __TO_B(sensor->bacc);
-	k1 = __TO_B_EXP(sensor->bacc);
-	k2 = __TO_R_EXP(sensor->bacc);
-
 	/* don't divide by zero */
-	if (m == 0)
+	if (__TO_M(sensor->mtol) == 0)
 		return 0;
 
-	result = (((val / pow(10, k2)) - (b * pow(10, k1))) / m);
-
-	if ((result - (int) result) >= .5)
-		return (uint8_t) ceil(result);
-	else
-		return (uint8_t) result;
+	t = __sdr_conv_table(sensor);
+	if (t)
+		reading = __sdr_conv_values(sensor, SDR_CONV_READING);
+	if (reading && !t->raw) {
+		t->raw = malloc(256);
+		if (t->raw)
+			t->raw_count = __sdr_raw_order(reading, t->raw);
+	}
+	if (reading && t->raw)
+		return __sdr_raw_nearest(reading, t->raw, t->raw_count, val);
+
+	/* sensor without tables: search a throwaway one */
+	for (i = 0; i < 256; i++)
+		tab[i] = __sdr_calc_sensor_reading(sensor, i);
+	count = __sdr_raw_order(tab, raw);
+	return __sdr_raw_nearest(tab, raw, count, val);
 }
 
 /* ipmi_sdr_get_sensor_thresholds  -  return thresholds for sensor
@@ -635,6 +921,30 @@ ipmi_sdr_get_sensor_thresholds(struct ipmi_intf *intf, uint8_t sensor,
 	uint8_t  bridged_request = 0;
 	uint32_t save_addr;
 	uint32_t save_channel;
+	static struct ipmi_rs cached;
+	int i;
+
+	/* thresholds fetched along with a batch of readings */
+	for (i = 0; i < sdr_readings_count; i++) {
+		struct sensor_reading *sr = &sdr_readings[i];
+		struct sdr_record_common_sensor *cmn;
+
+		if (!sr->s_thresh_state)
+			continue;
+		cmn = sr->full ? &sr->full->cmn : &sr->compact->cmn;
+		if (cmn->keys.sensor_num != sensor
+		    || cmn->keys.owner_id != target
+		    || cmn->keys.lun != lun
+		    || cmn->keys.channel != channel)
+			continue;
+		if (sr->s_thresh_state < 0)
+			return NULL;
+		memset(&cached, 0, sizeof(cached));
+		cached.ccode = sr->s_thresh_ccode;
+		cached.data_len = sr->s_thresh_len;
+		memcpy(cached.data, sr->s_thresh, sr->s_thresh_len);
+		return &cached;
+	}
 
 	if ( BRIDGE_TO_SENSOR(intf, target, channel) ) {
 		bridged_request = 1;
@@ -1554,77 +1864,95 @@ print_csv_discrete(struct ipmi_intf *intf,
 		sr->s_data3);
 }
 
-/* ipmi_sdr_read_sensor_value  -  read sensor value
+/* __sdr_sensor_reading_init  -  start a sensor reading
  *
- * @intf		Interface pointer
- * @sensor		Common sensor component pointer
- * @sdr_record_type	Type of sdr sensor record
- * @precision		decimal precision for analog format conversion
+ * @sr:			reading to initialize
+ * @sensor:		Common sensor component pointer
+ * @sdr_record_type:	Type of sdr sensor record
  *
- * returns a pointer to sensor value reading data structure
+ * returns 0 on success
+ * returns -1 if the record is not a full or compact sensor
  */
-struct sensor_reading *
-ipmi_sdr_read_sensor_value(struct ipmi_intf *intf,
-		 struct sdr_record_common_sensor *sensor,
-		 uint8_t sdr_record_type, int precision)
+static int
+__sdr_sensor_reading_init(struct sensor_reading *sr,
+			  struct sdr_record_common_sensor *sensor,
+			  uint8_t sdr_record_type)
 {
-	static struct sensor_reading sr;
-
-	if (!sensor)
-		return NULL;
+	unsigned int idlen;
 
 	/* Initialize to reading valid value of zero */
-	memset(&sr, 0, sizeof(sr));
+	memset(sr, 0, sizeof(*sr));
 
 	switch (sdr_record_type) {
-		unsigned int idlen;
 		case (SDR_RECORD_TYPE_FULL_SENSOR):
-			sr.full = (struct sdr_record_full_sensor *)sensor;
-			idlen = sr.full->id_code & 0x1f;
-			idlen = idlen < sizeof(sr.s_id) ?
-						idlen : sizeof(sr.s_id) - 1;
-			memcpy(sr.s_id, sr.full->id_string, idlen);
+			sr->full = (struct sdr_record_full_sensor *)sensor;
+			idlen = sr->full->id_code & 0x1f;
+			idlen = idlen < sizeof(sr->s_id) ?
+						idlen : sizeof(sr->s_id) - 1;
+			memcpy(sr->s_id, sr->full->id_string, idlen);
 			break;
 		case SDR_RECORD_TYPE_COMPACT_SENSOR:
-			sr.compact = (struct sdr_record_compact_sensor *)sensor;
-			idlen = sr.compact->id_code & 0x1f;
-			idlen = idlen < sizeof(sr.s_id) ?
-						idlen : sizeof(sr.s_id) - 1;
-			memcpy(sr.s_id, sr.compact->id_string, idlen);
+			sr->compact = (struct sdr_record_compact_sensor *)sensor;
+			idlen = sr->compact->id_code & 0x1f;
+			idlen = idlen < sizeof(sr->s_id) ?
+						idlen : sizeof(sr->s_id) - 1;
+			memcpy(sr->s_id, sr->compact->id_string, idlen);
 			break;
 		default:
-			return NULL;
+			return -1;
 	}
 
-	/*
-	 * Get current reading via IPMI interface
-	 */
-	struct ipmi_rs *rsp;
-	rsp = ipmi_sdr_get_sensor_reading_ipmb(intf,
-					       sensor->keys.sensor_num,
-					       sensor->keys.owner_id,
-					       sensor->keys.lun,
-					       sensor->keys.channel);
-	sr.s_a_val   = 0.0;	/* init analog value to a floating point 0 */
-	sr.s_a_str[0] = '\0';	/* no converted analog value string */
-	sr.s_a_units = "";	/* no converted analog units units */
+	sr->s_a_val   = 0.0;	/* init analog value to a floating point 0 */
+	sr->s_a_str[0] = '\0';	/* no converted analog value string */
+	sr->s_a_units = "";	/* no converted analog units units */
+
+	return 0;
+}
+
+/* __sdr_sensor_reading_format  -  format analog value of a reading
+ *
+ * @sr:		sensor reading
+ * @precision:	decimal precision for analog format conversion
+ */
+static void
+__sdr_sensor_reading_format(struct sensor_reading *sr, int precision)
+{
+	if (!sr->s_has_analog_value)
+		return;
 
+	snprintf(sr->s_a_str, sizeof(sr->s_a_str), "%.*f",
+		(sr->s_a_val == (int) sr->s_a_val) ? 0 :
+		precision, sr->s_a_val);
+}
 
+/* __sdr_sensor_reading_convert  -  fill reading from Get Sensor Reading
+ *
+ * @intf:	ipmi interface
+ * @sr:		reading set up by __sdr_sensor_reading_init()
+ * @sensor:	Common sensor component pointer
+ * @rsp:	Get Sensor Reading response, NULL if there was none
+ * @precision:	decimal precision for analog format conversion
+ */
+static void
+__sdr_sensor_reading_convert(struct ipmi_intf *intf, struct sensor_reading *sr,
+			     struct sdr_record_common_sensor *sensor,
+			     struct ipmi_rs *rsp, int precision)
+{
 	if (!rsp) {
 		lprintf(LOG_DEBUG, "Error reading sensor %s (#%02x)",
-			sr.s_id, sensor->keys.sensor_num);
-		return &sr;
+			sr->s_id, sensor->keys.sensor_num);
+		return;
 	}
 
 	if (rsp->ccode) {
-		if ( !((sr.full    && rsp->ccode == 0xcb) ||
-		       (sr.compact && rsp->ccode == 0xcd)) ) {
+		if ( !((sr->full    && rsp->ccode == 0xcb) ||
+		       (sr->compact && rsp->ccode == 0xcd)) ) {
 			lprintf(LOG_DEBUG,
-				"Error reading sensor %s (#%02x): %s", sr.s_id,
+				"Error reading sensor %s (#%02x): %s", sr->s_id,
 				sensor->keys.sensor_num,
 				val2str(rsp->ccode, completion_code_vals));
 		}
-		return &sr;
+		return;
 	}
 
 	if (rsp->data_len < 2) {
@@ -1635,81 +1963,338 @@ ipmi_sdr_read_sensor_value(struct ipmi_intf *intf,
 		 * a valid sensor reading.
 		 */
 		lprintf(LOG_DEBUG, "Error reading sensor %s invalid len %d",
-			sr.s_id, rsp->data_len);
-		return &sr;
+			sr->s_id, rsp->data_len);
+		return;
 	}
 
 
 	if (IS_READING_UNAVAILABLE(rsp->data[1]))
-		sr.s_reading_unavailable = 1;
+		sr->s_reading_unavailable = 1;
 
 	if (IS_SCANNING_DISABLED(rsp->data[1])) {
-		sr.s_scanning_disabled = 1;
+		sr->s_scanning_disabled = 1;
 		lprintf(LOG_DEBUG, "Sensor %s (#%02x) scanning disabled",
-			sr.s_id, sensor->keys.sensor_num);
-		return &sr;
+			sr->s_id, sensor->keys.sensor_num);
+		return;
 	}
-	if ( !sr.s_reading_unavailable ) {
-		sr.s_reading_valid = 1;
-		sr.s_reading = rsp->data[0];
+	if ( !sr->s_reading_unavailable ) {
+		sr->s_reading_valid = 1;
+		sr->s_reading = rsp->data[0];
 	}
 	if (rsp->data_len > 2)
-		sr.s_data2   = rsp->data[2];
+		sr->s_data2   = rsp->data[2];
 	if (rsp->data_len > 3)
-		sr.s_data3   = rsp->data[3];
-	if (sdr_sensor_has_analog_reading(intf, &sr)) {
-		sr.s_has_analog_value = 1;
-		if (sr.s_reading_valid) {
-			sr.s_a_val = sdr_convert_sensor_reading(sr.full, sr.s_reading);
+		sr->s_data3   = rsp->data[3];
+	if (sdr_sensor_has_analog_reading(intf, sr)) {
+		sr->s_has_analog_value = 1;
+		if (sr->s_reading_valid) {
+			sr->s_a_val = sdr_convert_sensor_reading(sr->full, sr->s_reading);
 		}
 		/* determine units string with possible modifiers */
-		sr.s_a_units = ipmi_sdr_get_unit_string(sr.full->cmn.unit.pct,
-					   sr.full->cmn.unit.modifier,
-					   sr.full->cmn.unit.type.base,
-					   sr.full->cmn.unit.type.modifier);
-		snprintf(sr.s_a_str, sizeof(sr.s_a_str), "%.*f",
-			(sr.s_a_val == (int) sr.s_a_val) ? 0 :
-			precision, sr.s_a_val);
+		sr->s_a_units = ipmi_sdr_get_unit_string(sr->full->cmn.unit.pct,
+					   sr->full->cmn.unit.modifier,
+					   sr->full->cmn.unit.type.base,
+					   sr->full->cmn.unit.type.modifier);
+		__sdr_sensor_reading_format(sr, precision);
 	}
-	return &sr;
 }
 
-/* ipmi_sdr_print_sensor_fc  -  print full & compact SDR records
+/* __sdr_find_reading  -  look up a prefetched sensor reading
  *
- * @intf:		ipmi interface
- * @sensor:		common sensor structure
- * @sdr_record_type:	type of sdr record, either full or compact
+ * Readings are usually looked up in the order they were read, so the
+ * search starts after the previous hit.
  *
- * returns 0 on success
- * returns -1 on error
+ * @sensor:	Common sensor component pointer
+ *
+ * returns prefetched reading
+ * returns NULL if the sensor was not prefetched
  */
-int
-ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
-			   struct sdr_record_common_sensor    *sensor,
-			   uint8_t sdr_record_type)
+static struct sensor_reading *
+__sdr_find_reading(const struct sdr_record_common_sensor *sensor)
 {
-	char sval[16];
-	unsigned int i = 0;
-	uint8_t target, lun, channel;
 	struct sensor_reading *sr;
+	int i, k;
+
+	for (i = 0; i < sdr_readings_count; i++) {
+		k = (sdr_readings_next + i) % sdr_readings_count;
+		sr = &sdr_readings[k];
+		if ((const void *)sr->full == (const void *)sensor
+		    || (const void *)sr->compact == (const void *)sensor) {
+			sdr_readings_next = k + 1;
+			return sr;
+		}
+	}
+	return NULL;
+}
 
+/* ipmi_sdr_read_sensor_value  -  read sensor value
+ *
+ * Readings prefetched with ipmi_sdr_set_readings() are returned without
+ * asking the BMC again.
+ *
+ * @intf		Interface pointer
+ * @sensor		Common sensor component pointer
+ * @sdr_record_type	Type of sdr sensor record
+ * @precision		decimal precision for analog format conversion
+ *
+ * returns a pointer to sensor value reading data structure
+ */
+struct sensor_reading *
+ipmi_sdr_read_sensor_value(struct ipmi_intf *intf,
+		 struct sdr_record_common_sensor *sensor,
+		 uint8_t sdr_record_type, int precision)
+{
+	static struct sensor_reading sr;
+	struct sensor_reading *cached;
 
-	sr = ipmi_sdr_read_sensor_value(intf, sensor, sdr_record_type, 2);
+	if (!sensor)
+		return NULL;
 
-	if (!sr)
-		return -1;
+	cached = __sdr_find_reading(sensor);
+	if (cached) {
+		memcpy(&sr, cached, sizeof(sr));
+		__sdr_sensor_reading_format(&sr, precision);
+		return &sr;
+	}
 
-	target = sensor->keys.owner_id;
-	lun = sensor->keys.lun;
-	channel = sensor->keys.channel;
+	if (__sdr_sensor_reading_init(&sr, sensor, sdr_record_type) < 0)
+		return NULL;
 
 	/*
-	 * CSV OUTPUT
+	 * Get current reading via IPMI interface
 	 */
+	struct ipmi_rs *rsp;
+	rsp = ipmi_sdr_get_sensor_reading_ipmb(intf,
+					       sensor->keys.sensor_num,
+					       sensor->keys.owner_id,
+					       sensor->keys.lun,
+					       sensor->keys.channel);
 
-	if (csv_output) {
-		/*
-		 * print sensor name, reading, unit, state
+	__sdr_sensor_reading_convert(intf, &sr, sensor, rsp, precision);
+	return &sr;
+}
+
+/* __sdr_reading_common  -  common sensor record behind a reading */
+static struct sdr_record_common_sensor *
+__sdr_reading_common(struct sensor_reading *sr)
+{
+	return sr->full ? &sr->full->cmn : &sr->compact->cmn;
+}
+
+/* ipmi_sdr_read_sensors  -  read a set of sensors in one pass
+ *
+ * The sensors are resolved against the SDR list once and all Get Sensor
+ * Reading (and optionally Get Sensor Thresholds) requests are handed to
+ * the transport in batches, so a pipelining interface keeps several of
+ * them in flight.  Sensors behind the same IPMB target share a batch.
+ *
+ * @intf:	ipmi interface
+ * @sensors:	array of *count SDR list entries, NULL for every sensor
+ * @count:	in: size of @sensors, out: number of readings returned
+ * @flags:	SDR_READ_THRESHOLDS to fetch thresholds of threshold sensors
+ * @precision:	decimal precision for analog format conversion
+ *
+ * returns allocated array of readings, to be freed by the caller
+ * returns NULL on error
+ */
+struct sensor_reading *
+ipmi_sdr_read_sensors(struct ipmi_intf *intf, struct sdr_record_list **sensors,
+		      int *count, int flags, int precision)
+{
+	struct sdr_record_list *e;
+	struct sensor_reading *sr;
+	struct ipmi_rq *req;
+	struct ipmi_rs *rsp;
+	int total, n, i, j, k, nreq, len;
+
+	if (!intf || !count || (sensors && *count < 0))
+		return NULL;
+
+	if (!sensors) {
+		if (!sdr_list_itr) {
+			sdr_list_itr = __sdr_list_start(intf);
+			if (!sdr_list_itr) {
+				lprintf(LOG_ERR, "Unable to open SDR for reading");
+				return NULL;
+			}
+		}
+		/* pull in whatever has not been read yet */
+		if (ipmi_sdr_list_cache(intf) < 0)
+			lprintf(LOG_DEBUG, "Some SDR records could not be read");
+		total = 0;
+		for (e = sdr_list_head; e; e = e->next)
+			total++;
+	} else {
+		total = *count;
+	}
+
+	sr = calloc(total ? total : 1, sizeof(*sr));
+	if (!sr) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return NULL;
+	}
+
+	n = 0;
+	e = sensors ? NULL : sdr_list_head;
+	for (i = 0; i < total; i++) {
+		if (sensors)
+			e = sensors[i];
+		if (e && e->record.common
+		    && (e->type == SDR_RECORD_TYPE_FULL_SENSOR
+			|| e->type == SDR_RECORD_TYPE_COMPACT_SENSOR)
+		    && __sdr_sensor_reading_init(&sr[n], e->record.common,
+						 e->type) == 0)
+			n++;
+		if (!sensors)
+			e = e->next;
+	}
+
+	req = calloc(SDR_READ_CHUNK, sizeof(*req));
+	rsp = calloc(SDR_READ_CHUNK, sizeof(*rsp));
+	if (!req || !rsp) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		free(req);
+		free(rsp);
+		free(sr);
+		return NULL;
+	}
+
+	for (i = 0; i < n; i = j) {
+		struct sdr_record_common_sensor *cmn = __sdr_reading_common(&sr[i]);
+		uint8_t target = cmn->keys.owner_id;
+		uint8_t channel = cmn->keys.channel;
+		uint8_t  bridged_request = 0;
+		uint32_t save_addr;
+		uint32_t save_channel;
+
+		nreq = 0;
+		for (j = i; j < n; j++) {
+			int thresh;
+
+			cmn = __sdr_reading_common(&sr[j]);
+			if (cmn->keys.owner_id != target
+			    || cmn->keys.channel != channel)
+				break;
+			thresh = (flags & SDR_READ_THRESHOLDS)
+				 && IS_THRESHOLD_SENSOR(cmn);
+			if (nreq + 1 + thresh > SDR_READ_CHUNK)
+				break;
+
+			memset(&req[nreq], 0, sizeof(req[nreq]));
+			req[nreq].msg.netfn = IPMI_NETFN_SE;
+			req[nreq].msg.lun = cmn->keys.lun;
+			req[nreq].msg.cmd = GET_SENSOR_READING;
+			req[nreq].msg.data = &cmn->keys.sensor_num;
+			req[nreq].msg.data_len = 1;
+			nreq++;
+			if (thresh) {
+				req[nreq] = req[nreq - 1];
+				req[nreq].msg.cmd = GET_SENSOR_THRESHOLDS;
+				nreq++;
+			}
+		}
+
+		if ( BRIDGE_TO_SENSOR(intf, target, channel) ) {
+			bridged_request = 1;
+			save_addr = intf->target_addr;
+			intf->target_addr = target;
+			save_channel = intf->target_channel;
+			intf->target_channel = channel;
+		}
+		if (ipmi_intf_sendrecv_multi(intf, req, rsp, nreq) < 0) {
+			for (k = 0; k < nreq; k++)
+				rsp[k].data_len = -1;
+		}
+		if (bridged_request) {
+			intf->target_addr    = save_addr;
+			intf->target_channel = save_channel;
+		}
+
+		nreq = 0;
+		for (k = i; k < j; k++) {
+			cmn = __sdr_reading_common(&sr[k]);
+			__sdr_sensor_reading_convert(intf, &sr[k], cmn,
+				rsp[nreq].data_len < 0 ? NULL : &rsp[nreq],
+				precision);
+			nreq++;
+			if ((flags & SDR_READ_THRESHOLDS)
+			    && IS_THRESHOLD_SENSOR(cmn)) {
+				if (rsp[nreq].data_len < 0) {
+					sr[k].s_thresh_state = -1;
+				} else {
+					sr[k].s_thresh_state = 1;
+					sr[k].s_thresh_ccode = rsp[nreq].ccode;
+					len = rsp[nreq].data_len;
+					if (len > (int)sizeof(sr[k].s_thresh))
+						len = sizeof(sr[k].s_thresh);
+					sr[k].s_thresh_len = len;
+					memcpy(sr[k].s_thresh, rsp[nreq].data,
+					       sr[k].s_thresh_len);
+				}
+				nreq++;
+			}
+		}
+	}
+
+	free(req);
+	free(rsp);
+	*count = n;
+	return sr;
+}
+
+/* ipmi_sdr_set_readings  -  hand prefetched readings to the printers
+ *
+ * While set, ipmi_sdr_read_sensor_value() and
+ * ipmi_sdr_get_sensor_thresholds() answer from @sr instead of asking the
+ * BMC.  The caller keeps ownership and must clear it before freeing.
+ *
+ * @sr:		readings from ipmi_sdr_read_sensors(), NULL to clear
+ * @count:	number of readings
+ */
+void
+ipmi_sdr_set_readings(struct sensor_reading *sr, int count)
+{
+	sdr_readings = sr;
+	sdr_readings_count = sr ? count : 0;
+	sdr_readings_next = 0;
+}
+
+/* ipmi_sdr_print_sensor_fc  -  print full & compact SDR records
+ *
+ * @intf:		ipmi interface
+ * @sensor:		common sensor structure
+ * @sdr_record_type:	type of sdr record, either full or compact
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_sdr_print_sensor_fc(struct ipmi_intf *intf,
+			   struct sdr_record_common_sensor    *sensor,
+			   uint8_t sdr_record_type)
+{
+	char sval[16];
+	unsigned int i = 0;
+	uint8_t target, lun, channel;
+	struct sensor_reading *sr;
+
+
+	sr = ipmi_sdr_read_sensor_value(intf, sensor, sdr_record_type, 2);
+
+	if (!sr)
+		return -1;
+
+	target = sensor->keys.owner_id;
+	lun = sensor->keys.lun;
+	channel = sensor->keys.channel;
+
+	/*
+	 * CSV OUTPUT
+	 */
+
+	if (csv_output) {
+		/*
+		 * print sensor name, reading, unit, state
 		 */
 		printf("%s,", sr->s_id);
 		if (!IS_THRESHOLD_SENSOR(sensor)) {
@@ -2799,18 +3384,28 @@ ipmi_sdr_print_sdr(struct ipmi_intf *intf, uint8_t type)
 {
 	struct sdr_get_rs *header;
 	struct sdr_record_list *e;
+	struct sensor_reading *sr = NULL;
+	int count = 0;
 	int rc = 0;
 
 	lprintf(LOG_DEBUG, "Querying SDR for sensor list");
 
 	if (!sdr_list_itr) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
+		sdr_list_itr = __sdr_list_start(intf);
 		if (!sdr_list_itr) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return -1;
 		}
 	}
 
+	/* read all sensors in one batch before printing them */
+	if (type == 0xff || type == 0xfe
+	    || type == SDR_RECORD_TYPE_FULL_SENSOR
+	    || type == SDR_RECORD_TYPE_COMPACT_SENSOR) {
+		sr = ipmi_sdr_read_sensors(intf, NULL, &count, 0, 2);
+		ipmi_sdr_set_readings(sr, count);
+	}
+
 	for (e = sdr_list_head; e; e = e->next) {
 		if (type != e->type && type != 0xff && type != 0xfe)
 			continue;
@@ -2893,15 +3488,13 @@ ipmi_sdr_print_sdr(struct ipmi_intf *intf, uint8_t type)
 				rc = -1;
 		}
 
-		/* add to global record liset */
-		if (!sdr_list_head)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(sdrr);
 	}
 
+	ipmi_sdr_set_readings(NULL, 0);
+	free(sr);
+
 	return rc;
 }
 
@@ -3091,6 +3684,67 @@ ipmi_sdr_start(struct ipmi_intf *intf, int use_builtin)
 	return itr;
 }
 
+/* __sdr_get_record_multi  -  read SDR record chunks as one batch
+ *
+ * Issues all partial reads of a record at once so a pipelined
+ * interface can keep them in flight together.
+ *
+ * @intf:	ipmi interface
+ * @req:	request template
+ * @tmpl:	Get SDR request template (reservation and record id)
+ * @data:	buffer for the record body
+ * @len:	record body length
+ *
+ * returns number of leading bytes that were read successfully
+ */
+static int
+__sdr_get_record_multi(struct ipmi_intf *intf, struct ipmi_rq *req,
+		       struct sdr_get_rq *tmpl, uint8_t *data, int len)
+{
+	struct ipmi_rq *reqs;
+	struct ipmi_rs *rsps;
+	struct sdr_get_rq *sdr_rqs;
+	int n, k, read = 0;
+
+	n = (len + sdr_max_read_len - 1) / sdr_max_read_len;
+
+	reqs = malloc(n * sizeof(struct ipmi_rq));
+	rsps = malloc(n * sizeof(struct ipmi_rs));
+	sdr_rqs = malloc(n * sizeof(struct sdr_get_rq));
+	if (!reqs || !rsps || !sdr_rqs) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		goto out;
+	}
+
+	for (k = 0; k < n; k++) {
+		memcpy(&sdr_rqs[k], tmpl, sizeof(struct sdr_get_rq));
+		sdr_rqs[k].offset = k * sdr_max_read_len + 5;	/* 5 header bytes */
+		sdr_rqs[k].length = __min(len - k * sdr_max_read_len,
+					  sdr_max_read_len);
+		memcpy(&reqs[k], req, sizeof(struct ipmi_rq));
+		reqs[k].msg.data = (uint8_t *)&sdr_rqs[k];
+	}
+
+	lprintf(LOG_DEBUG, "Getting %d bytes from SDR in %d reads", len, n);
+
+	if (ipmi_intf_sendrecv_multi(intf, reqs, rsps, n) < 0)
+		goto out;
+
+	/* stop at the first chunk that needs the careful path */
+	for (k = 0; k < n; k++) {
+		if (rsps[k].data_len < sdr_rqs[k].length + 2 || rsps[k].ccode)
+			break;
+		memcpy(data + read, rsps[k].data + 2, sdr_rqs[k].length);
+		read += sdr_rqs[k].length;
+	}
+
+out:
+	free(reqs);
+	free(rsps);
+	free(sdr_rqs);
+	return read;
+}
+
 /* ipmi_sdr_get_record  -  return RAW SDR record
  *
  * @intf:	ipmi interface
@@ -3147,6 +3801,12 @@ ipmi_sdr_get_record(struct ipmi_intf * intf, struct sdr_get_rs * header,
 		}
 	}
 
+	/* with a pipelined interface fetch all partial reads at once,
+	 * whatever did not come back cleanly is read again below
+	 */
+	if (intf->ssn_params.window > 1 && len > sdr_max_read_len)
+		i = __sdr_get_record_multi(intf, &req, &sdr_rq, data, len);
+
 	/* read SDR record with partial reads
 	 * because a full read usually exceeds the maximum
 	 * transport buffer size.  (completion code 0xca)
@@ -3218,21 +3878,236 @@ ipmi_sdr_end(struct ipmi_sdr_iterator *itr)
 	}
 }
 
+/* __sdr_hash_num  -  index bucket for sensor owner and number
+ *
+ * @owner:	sensor owner ID
+ * @num:	sensor number
+ *
+ * returns bucket number
+ */
+static unsigned int
+__sdr_hash_num(uint8_t owner, uint8_t num)
+{
+	return (owner * 31 + num) & (SDR_HASH_SIZE - 1);
+}
+
+/* __sdr_hash_id  -  index bucket for sensor ID string
+ *
+ * @id:		ID string, need not be NUL terminated
+ * @len:	maximum length of ID string
+ *
+ * returns bucket number
+ */
+static unsigned int
+__sdr_hash_id(const uint8_t *id, int len)
+{
+	uint32_t hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < len && id[i]; i++) {
+		hash ^= id[i];
+		hash *= 16777619U;
+	}
+
+	return hash & (SDR_HASH_SIZE - 1);
+}
+
+/* __sdr_hash_insert  -  append SDR list entry to an index chain
+ *
+ * @bucket:	index bucket
+ * @entry:	SDR list entry
+ * @link:	chain pointer of @entry that belongs to this index
+ *
+ * no meaningful return code
+ */
+static void
+__sdr_hash_insert(struct sdr_hash_bucket *bucket,
+		  struct sdr_record_list *entry,
+		  struct sdr_record_list **link)
+{
+	*link = NULL;
+	if (bucket->head)
+		*bucket->tail = entry;
+	else
+		bucket->head = entry;
+	bucket->tail = link;
+}
+
+/* __sdr_record_id_string  -  locate ID string of SDR list entry
+ *
+ * @entry:	SDR list entry
+ * @len:	filled with length of ID string
+ *
+ * returns pointer to ID string
+ * returns NULL if record has no ID string
+ */
+static const uint8_t *
+__sdr_record_id_string(struct sdr_record_list *entry, int *len)
+{
+	switch (entry->type) {
+	case SDR_RECORD_TYPE_FULL_SENSOR:
+		*len = entry->record.full->id_code & 0x1f;
+		return entry->record.full->id_string;
+	case SDR_RECORD_TYPE_COMPACT_SENSOR:
+		*len = entry->record.compact->id_code & 0x1f;
+		return entry->record.compact->id_string;
+	case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
+		*len = entry->record.eventonly->id_code & 0x1f;
+		return entry->record.eventonly->id_string;
+	case SDR_RECORD_TYPE_GENERIC_DEVICE_LOCATOR:
+		*len = entry->record.genloc->id_code & 0x1f;
+		return entry->record.genloc->id_string;
+	case SDR_RECORD_TYPE_FRU_DEVICE_LOCATOR:
+		*len = entry->record.fruloc->id_code & 0x1f;
+		return entry->record.fruloc->id_string;
+	case SDR_RECORD_TYPE_MC_DEVICE_LOCATOR:
+		*len = entry->record.mcloc->id_code & 0x1f;
+		return entry->record.mcloc->id_string;
+	}
+	return NULL;
+}
+
+/* ipmi_sdr_get_id_string  -  copy ID string of SDR list entry
+ *
+ * @entry:	SDR list entry
+ * @buf:	buffer for the NUL terminated ID string
+ * @len:	size of buffer
+ *
+ * returns 0 on success
+ * returns -1 if record has no ID string
+ */
+int
+ipmi_sdr_get_id_string(struct sdr_record_list *entry, char *buf, size_t len)
+{
+	const uint8_t *id;
+	int idlen;
+
+	if (!entry || !entry->record.common || len == 0)
+		return -1;
+
+	id = __sdr_record_id_string(entry, &idlen);
+	if (!id)
+		return -1;
+
+	snprintf(buf, len, "%.*s", idlen, (const char *)id);
+	return 0;
+}
+
+/* __sdr_record_entity  -  locate entity of SDR list entry
+ *
+ * @entry:	SDR list entry
+ *
+ * returns pointer to entity id/instance
+ * returns NULL if record has no entity
+ */
+static struct entity_id *
+__sdr_record_entity(struct sdr_record_list *entry)
+{
+	switch (entry->type) {
+	case SDR_RECORD_TYPE_FULL_SENSOR:
+	case SDR_RECORD_TYPE_COMPACT_SENSOR:
+		return &entry->record.common->entity;
+	case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
+		return &entry->record.eventonly->entity;
+	case SDR_RECORD_TYPE_GENERIC_DEVICE_LOCATOR:
+		return &entry->record.genloc->entity;
+	case SDR_RECORD_TYPE_FRU_DEVICE_LOCATOR:
+		return &entry->record.fruloc->entity;
+	case SDR_RECORD_TYPE_MC_DEVICE_LOCATOR:
+		return &entry->record.mcloc->entity;
+	case SDR_RECORD_TYPE_ENTITY_ASSOC:
+		return &entry->record.entassoc->entity;
+	}
+	return NULL;
+}
+
+/* __sdr_hash_buckets  -  index buckets of SDR list entry
+ *
+ * @entry:	SDR list entry
+ * @bucket:	filled with the bucket in each index, -1 if the record
+ *		is not part of that index
+ *
+ * no meaningful return code
+ */
+static void
+__sdr_hash_buckets(struct sdr_record_list *entry, int bucket[SDR_INDEX_MAX])
+{
+	const uint8_t *id;
+	struct entity_id *entity;
+	int i, len;
+
+	for (i = 0; i < SDR_INDEX_MAX; i++)
+		bucket[i] = -1;
+
+	/* raw records of an SDR dump are not decoded */
+	if (!entry->record.common)
+		return;
+
+	switch (entry->type) {
+	case SDR_RECORD_TYPE_FULL_SENSOR:
+	case SDR_RECORD_TYPE_COMPACT_SENSOR:
+		bucket[SDR_INDEX_NUM] = __sdr_hash_num(
+			entry->record.common->keys.owner_id,
+			entry->record.common->keys.sensor_num);
+		break;
+	case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
+		bucket[SDR_INDEX_NUM] = __sdr_hash_num(
+			entry->record.eventonly->keys.owner_id,
+			entry->record.eventonly->keys.sensor_num);
+		break;
+	}
+
+	id = __sdr_record_id_string(entry, &len);
+	if (id)
+		bucket[SDR_INDEX_ID] = __sdr_hash_id(id, len);
+
+	entity = __sdr_record_entity(entry);
+	if (entity)
+		bucket[SDR_INDEX_ENTITY] = entity->id % SDR_HASH_SIZE;
+}
+
+/* __sdr_list_append  -  add entry to global SDR list and its indexes
+ *
+ * @sdrr:	new entry, with its record already attached
+ *
+ * no meaningful return code
+ */
+static void
+__sdr_list_append(struct sdr_record_list *sdrr)
+{
+	int bucket[SDR_INDEX_MAX];
+	int i;
+
+	sdrr->next = NULL;
+	if (!sdr_list_head)
+		sdr_list_head = sdrr;
+	else
+		sdr_list_tail->next = sdrr;
+
+	sdr_list_tail = sdrr;
+
+	__sdr_hash_buckets(sdrr, bucket);
+	for (i = 0; i < SDR_INDEX_MAX; i++) {
+		if (bucket[i] >= 0)
+			__sdr_hash_insert(&sdr_hash[i][bucket[i]], sdrr,
+					  &sdrr->hash_next[i]);
+	}
+}
+
 /* __sdr_list_add  -  helper function to add SDR record to list
  *
- * @head:	list head
+ * @tail:	last entry of list, moved to the new entry
  * @entry:	new entry to add to end of list
  *
  * returns 0 on success
  * returns -1 on error
  */
 static int
-__sdr_list_add(struct sdr_record_list *head, struct sdr_record_list *entry)
+__sdr_list_add(struct sdr_record_list **tail, struct sdr_record_list *entry)
 {
-	struct sdr_record_list *e;
 	struct sdr_record_list *new;
 
-	if (!head)
+	if (!tail || !*tail)
 		return -1;
 
 	new = malloc(sizeof (struct sdr_record_list));
@@ -3242,11 +4117,9 @@ __sdr_list_add(struct sdr_record_list *head, struct sdr_record_list *entry)
 	}
 	memcpy(new, entry, sizeof (struct sdr_record_list));
 
-	e = head;
-	while (e->next)
-		e = e->next;
-	e->next = new;
 	new->next = NULL;
+	(*tail)->next = new;
+	*tail = new;
 
 	return 0;
 }
@@ -3281,6 +4154,16 @@ ipmi_sdr_list_empty(void)
 	ipmi_sdr_end(sdr_list_itr);
 
 	for (list = sdr_list_head; list; list = next) {
+		next = list->next;
+
+		__sdr_conv_free(list->conv);
+		list->conv = NULL;
+
+		/* entries of a mapped cache are released below */
+		if (sdr_cache_nodes && list >= sdr_cache_nodes
+		    && list < sdr_cache_nodes + sdr_cache_count)
+			continue;
+
 		switch (list->type) {
 		case SDR_RECORD_TYPE_FULL_SENSOR:
 		case SDR_RECORD_TYPE_COMPACT_SENSOR:
@@ -3320,14 +4203,24 @@ ipmi_sdr_list_empty(void)
 			}
 			break;
 		}
-		next = list->next;
 		free(list);
 		list = NULL;
 	}
 
+	if (sdr_cache_map) {
+		munmap(sdr_cache_map, sdr_cache_map_len);
+		free(sdr_cache_nodes);
+		sdr_cache_map = NULL;
+		sdr_cache_map_len = 0;
+		sdr_cache_nodes = NULL;
+		sdr_cache_count = 0;
+	}
+
 	sdr_list_head = NULL;
 	sdr_list_tail = NULL;
 	sdr_list_itr = NULL;
+
+	memset(sdr_hash, 0, sizeof (sdr_hash));
 }
 
 /* ipmi_sdr_find_sdr_bynumtype  -  lookup SDR entry by number/type
@@ -3348,7 +4241,7 @@ ipmi_sdr_find_sdr_bynumtype(struct ipmi_intf *intf, uint16_t gen_id, uint8_t num
 	int found = 0;
 
 	if (!sdr_list_itr) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
+		sdr_list_itr = __sdr_list_start(intf);
 		if (!sdr_list_itr) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return NULL;
@@ -3356,7 +4249,8 @@ ipmi_sdr_find_sdr_bynumtype(struct ipmi_intf *intf, uint16_t gen_id, uint8_t num
 	}
 
 	/* check what we've already read */
-	for (e = sdr_list_head; e; e = e->next) {
+	for (e = sdr_hash[SDR_INDEX_NUM][__sdr_hash_num(gen_id & 0x00ff, num)].head;
+	     e; e = e->hash_next[SDR_INDEX_NUM]) {
 		switch (e->type) {
 		case SDR_RECORD_TYPE_FULL_SENSOR:
 		case SDR_RECORD_TYPE_COMPACT_SENSOR:
@@ -3441,13 +4335,8 @@ ipmi_sdr_find_sdr_bynumtype(struct ipmi_intf *intf, uint16_t gen_id, uint8_t num
 			continue;
 		}
 
-		/* put in the global record list */
-		if (!sdr_list_head)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(sdrr);
 
 		if (found)
 			return sdrr;
@@ -3468,11 +4357,12 @@ struct sdr_record_list *
 ipmi_sdr_find_sdr_bysensortype(struct ipmi_intf *intf, uint8_t type)
 {
 	struct sdr_record_list *head;
+	struct sdr_record_list *tail;
 	struct sdr_get_rs *header;
 	struct sdr_record_list *e;
 
 	if (!sdr_list_itr) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
+		sdr_list_itr = __sdr_list_start(intf);
 		if (!sdr_list_itr) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return NULL;
@@ -3486,17 +4376,18 @@ ipmi_sdr_find_sdr_bysensortype(struct ipmi_intf *intf, uint8_t type)
 		return NULL;
 	}
 	memset(head, 0, sizeof (struct sdr_record_list));
+	tail = head;
 
 	for (e = sdr_list_head; e; e = e->next) {
 		switch (e->type) {
 		case SDR_RECORD_TYPE_FULL_SENSOR:
 		case SDR_RECORD_TYPE_COMPACT_SENSOR:
 			if (e->record.common->sensor.type == type)
-				__sdr_list_add(head, e);
+				__sdr_list_add(&tail, e);
 			break;
 		case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
 			if (e->record.eventonly->sensor_type == type)
-				__sdr_list_add(head, e);
+				__sdr_list_add(&tail, e);
 			break;
 		}
 	}
@@ -3530,13 +4421,13 @@ ipmi_sdr_find_sdr_bysensortype(struct ipmi_intf *intf, uint8_t type)
 			sdrr->record.common =
 			    (struct sdr_record_common_sensor *) rec;
 			if (sdrr->record.common->sensor.type == type)
-				__sdr_list_add(head, sdrr);
+				__sdr_list_add(&tail, sdrr);
 			break;
 		case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
 			sdrr->record.eventonly =
 			    (struct sdr_record_eventonly_sensor *) rec;
 			if (sdrr->record.eventonly->sensor_type == type)
-				__sdr_list_add(head, sdrr);
+				__sdr_list_add(&tail, sdrr);
 			break;
 		case SDR_RECORD_TYPE_GENERIC_DEVICE_LOCATOR:
 			sdrr->record.genloc =
@@ -3564,13 +4455,8 @@ ipmi_sdr_find_sdr_bysensortype(struct ipmi_intf *intf, uint8_t type)
 			continue;
 		}
 
-		/* put in the global record list */
-		if (!sdr_list_head)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(sdrr);
 	}
 
 	return head;
@@ -3590,9 +4476,10 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 	struct sdr_get_rs *header;
 	struct sdr_record_list *e;
 	struct sdr_record_list *head;
+	struct sdr_record_list *tail;
 
 	if (!sdr_list_itr) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
+		sdr_list_itr = __sdr_list_start(intf);
 		if (!sdr_list_itr) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return NULL;
@@ -3605,9 +4492,11 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 		return NULL;
 	}
 	memset(head, 0, sizeof (struct sdr_record_list));
+	tail = head;
 
 	/* check what we've already read */
-	for (e = sdr_list_head; e; e = e->next) {
+	for (e = sdr_hash[SDR_INDEX_ENTITY][entity->id % SDR_HASH_SIZE].head;
+	     e; e = e->hash_next[SDR_INDEX_ENTITY]) {
 		switch (e->type) {
 		case SDR_RECORD_TYPE_FULL_SENSOR:
 		case SDR_RECORD_TYPE_COMPACT_SENSOR:
@@ -3615,42 +4504,42 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 			    (entity->instance == 0x7f ||
 			     e->record.common->entity.instance ==
 			     entity->instance))
-				__sdr_list_add(head, e);
+				__sdr_list_add(&tail, e);
 			break;
 		case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
 			if (e->record.eventonly->entity.id == entity->id &&
 			    (entity->instance == 0x7f ||
 			     e->record.eventonly->entity.instance ==
 			     entity->instance))
-				__sdr_list_add(head, e);
+				__sdr_list_add(&tail, e);
 			break;
 		case SDR_RECORD_TYPE_GENERIC_DEVICE_LOCATOR:
 			if (e->record.genloc->entity.id == entity->id &&
 			    (entity->instance == 0x7f ||
 			     e->record.genloc->entity.instance ==
 			     entity->instance))
-				__sdr_list_add(head, e);
+				__sdr_list_add(&tail, e);
 			break;
 		case SDR_RECORD_TYPE_FRU_DEVICE_LOCATOR:
 			if (e->record.fruloc->entity.id == entity->id &&
 			    (entity->instance == 0x7f ||
 			     e->record.fruloc->entity.instance ==
 			     entity->instance))
-				__sdr_list_add(head, e);
+				__sdr_list_add(&tail, e);
 			break;
 		case SDR_RECORD_TYPE_MC_DEVICE_LOCATOR:
 			if (e->record.mcloc->entity.id == entity->id &&
 			    (entity->instance == 0x7f ||
 			     e->record.mcloc->entity.instance ==
 			     entity->instance))
-				__sdr_list_add(head, e);
+				__sdr_list_add(&tail, e);
 			break;
 		case SDR_RECORD_TYPE_ENTITY_ASSOC:
 			if (e->record.entassoc->entity.id == entity->id &&
 			    (entity->instance == 0x7f ||
 			     e->record.entassoc->entity.instance ==
 			     entity->instance))
-				__sdr_list_add(head, e);
+				__sdr_list_add(&tail, e);
 			break;
 		}
 	}
@@ -3687,7 +4576,7 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 			    && (entity->instance == 0x7f
 				|| sdrr->record.common->entity.instance ==
 				entity->instance))
-				__sdr_list_add(head, sdrr);
+				__sdr_list_add(&tail, sdrr);
 			break;
 		case SDR_RECORD_TYPE_EVENTONLY_SENSOR:
 			sdrr->record.eventonly =
@@ -3696,7 +4585,7 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 			    && (entity->instance == 0x7f
 				|| sdrr->record.eventonly->entity.instance ==
 				entity->instance))
-				__sdr_list_add(head, sdrr);
+				__sdr_list_add(&tail, sdrr);
 			break;
 		case SDR_RECORD_TYPE_GENERIC_DEVICE_LOCATOR:
 			sdrr->record.genloc =
@@ -3705,7 +4594,7 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 			    && (entity->instance == 0x7f
 				|| sdrr->record.genloc->entity.instance ==
 				entity->instance))
-				__sdr_list_add(head, sdrr);
+				__sdr_list_add(&tail, sdrr);
 			break;
 		case SDR_RECORD_TYPE_FRU_DEVICE_LOCATOR:
 			sdrr->record.fruloc =
@@ -3714,7 +4603,7 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 			    && (entity->instance == 0x7f
 				|| sdrr->record.fruloc->entity.instance ==
 				entity->instance))
-				__sdr_list_add(head, sdrr);
+				__sdr_list_add(&tail, sdrr);
 			break;
 		case SDR_RECORD_TYPE_MC_DEVICE_LOCATOR:
 			sdrr->record.mcloc =
@@ -3723,7 +4612,7 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 			    && (entity->instance == 0x7f
 				|| sdrr->record.mcloc->entity.instance ==
 				entity->instance))
-				__sdr_list_add(head, sdrr);
+				__sdr_list_add(&tail, sdrr);
 			break;
 		case SDR_RECORD_TYPE_ENTITY_ASSOC:
 			sdrr->record.entassoc =
@@ -3732,7 +4621,7 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 			    && (entity->instance == 0x7f
 				|| sdrr->record.entassoc->entity.instance ==
 				entity->instance))
-				__sdr_list_add(head, sdrr);
+				__sdr_list_add(&tail, sdrr);
 			break;
 		default:
 			free(rec);
@@ -3745,12 +4634,7 @@ ipmi_sdr_find_sdr_byentity(struct ipmi_intf *intf, struct entity_id *entity)
 		}
 
 		/* add to global record list */
-		if (!sdr_list_head)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		__sdr_list_append(sdrr);
 	}
 
 	return head;
@@ -3770,9 +4654,10 @@ ipmi_sdr_find_sdr_bytype(struct ipmi_intf *intf, uint8_t type)
 	struct sdr_get_rs *header;
 	struct sdr_record_list *e;
 	struct sdr_record_list *head;
+	struct sdr_record_list *tail;
 
 	if (!sdr_list_itr) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
+		sdr_list_itr = __sdr_list_start(intf);
 		if (!sdr_list_itr) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return NULL;
@@ -3785,11 +4670,12 @@ ipmi_sdr_find_sdr_bytype(struct ipmi_intf *intf, uint8_t type)
 		return NULL;
 	}
 	memset(head, 0, sizeof (struct sdr_record_list));
+	tail = head;
 
 	/* check what we've already read */
 	for (e = sdr_list_head; e; e = e->next)
 		if (e->type == type)
-			__sdr_list_add(head, e);
+			__sdr_list_add(&tail, e);
 
 	/* now keep looking */
 	while ((header = ipmi_sdr_get_next_header(intf, sdr_list_itr))) {
@@ -3851,15 +4737,10 @@ ipmi_sdr_find_sdr_bytype(struct ipmi_intf *intf, uint8_t type)
 		}
 
 		if (header->type == type)
-			__sdr_list_add(head, sdrr);
+			__sdr_list_add(&tail, sdrr);
 
 		/* add to global record list */
-		if (!sdr_list_head)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		__sdr_list_append(sdrr);
 	}
 
 	return head;
@@ -3887,7 +4768,7 @@ ipmi_sdr_find_sdr_byid(struct ipmi_intf *intf, char *id)
 	idlen = strlen(id);
 
 	if (!sdr_list_itr) {
-		sdr_list_itr = ipmi_sdr_start(intf, 0);
+		sdr_list_itr = __sdr_list_start(intf);
 		if (!sdr_list_itr) {
 			lprintf(LOG_ERR, "Unable to open SDR for reading");
 			return NULL;
@@ -3895,7 +4776,9 @@ ipmi_sdr_find_sdr_byid(struct ipmi_intf *intf, char *id)
 	}
 
 	/* check what we've already read */
-	for (e = sdr_list_head; e; e = e->next) {
+	for (e = sdr_hash[SDR_INDEX_ID][__sdr_hash_id((const uint8_t *)id,
+							idlen)].head;
+	     e; e = e->hash_next[SDR_INDEX_ID]) {
 		switch (e->type) {
 		case SDR_RECORD_TYPE_FULL_SENSOR:
 			if (!strncmp((const char *)e->record.full->id_string,
@@ -4030,13 +4913,8 @@ ipmi_sdr_find_sdr_byid(struct ipmi_intf *intf, char *id)
 			continue;
 		}
 
-		/* add to global record liset */
-		if (!sdr_list_head)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(sdrr);
 
 		if (found)
 			return sdrr;
@@ -4045,17 +4923,332 @@ ipmi_sdr_find_sdr_byid(struct ipmi_intf *intf, char *id)
 	return NULL;
 }
 
-/* ipmi_sdr_list_cache_fromfile  -  generate SDR cache for fast lookup from local file
+/*
+ * SDR cache files
  *
- * @ifile:	input filename
+ * A cache file is mapped read-only and its records are used in place.
+ * It starts with struct sdr_cache_header, followed by the records in
+ * 'sdr dump' format and, 4-byte aligned, by these tables:
  *
- * returns pointer to SDR list
- * returns NULL on error
+ *   uint32_t offset[count]			file offset of each record
+ *   uint32_t head[SDR_INDEX_MAX][hash_size]	first record of each bucket
+ *   uint32_t tail[SDR_INDEX_MAX][hash_size]	last record of each bucket
+ *   uint32_t next[SDR_INDEX_MAX][count]		next record in the bucket
+ *
+ * Index tables number records from 1, 0 ends a chain.  They hold the
+ * chains __sdr_list_append() would build, so SDR_CACHE_VERSION must be
+ * bumped whenever the hash functions change.  Header and tables are in
+ * host byte order.
  */
-int
-ipmi_sdr_list_cache_fromfile(const char *ifile)
+#define SDR_CACHE_MAGIC		"ISDR"
+#define SDR_CACHE_VERSION	2
+#define SDR_CACHE_BYTE_ORDER	0x01020304
+
+struct sdr_cache_header {
+	char magic[4];
+	uint8_t version;
+	uint8_t __reserved[3];
+	uint8_t add_stamp[4];
+	uint8_t erase_stamp[4];
+	uint32_t byte_order;	/* SDR_CACHE_BYTE_ORDER */
+	uint32_t size;		/* file size */
+	uint32_t count;		/* number of records */
+	uint32_t hash_size;	/* buckets per index */
+	uint32_t table;		/* offset of record offset table */
+};
+
+/* number of uint32_t in the tables of a cache file */
+#define SDR_CACHE_TABLE_LEN(count) \
+	((count) * (1 + SDR_INDEX_MAX) + 2 * SDR_INDEX_MAX * SDR_HASH_SIZE)
+
+/* __sdr_cache_map  -  load SDR list from a mapped cache file
+ *
+ * The global SDR list must be empty.  Its entries are allocated in one
+ * block and point into the mapping, which stays until
+ * ipmi_sdr_list_empty().
+ *
+ * @path:	cache file name
+ * @info:	current repository info of the BMC, the cache is only
+ *		used if its timestamps match; NULL to skip the check
+ *
+ * returns 0 if the list was loaded
+ * returns -1 if there is no valid cache
+ */
+static int
+__sdr_cache_map(const char *path, struct get_sdr_repository_info_rsp *info)
+{
+	const struct sdr_cache_header *hdr;
+	const uint32_t *offset, *head, *tail, *next;
+	struct sdr_record_list *nodes = NULL;
+	struct stat st;
+	uint8_t *map;
+	uint32_t count, n, v;
+	int fd, i, b;
+
+	if (sdr_list_head) {
+		lprintf(LOG_ERR, "SDR list is already loaded");
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		lprintf(LOG_DEBUG, "No SDR cache %s", path);
+		return -1;
+	}
+	if (fstat(fd, &st) < 0
+	    || st.st_size < (off_t)sizeof (struct sdr_cache_header)
+	    || st.st_size > UINT32_MAX)
+	{
+		lprintf(LOG_DEBUG, "SDR cache %s is stale", path);
+		close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		lperror(LOG_WARN, "Unable to map SDR cache %s", path);
+		return -1;
+	}
+
+	hdr = (const struct sdr_cache_header *)map;
+	if (memcmp(hdr->magic, SDR_CACHE_MAGIC, sizeof (hdr->magic))
+	    || hdr->version != SDR_CACHE_VERSION
+	    || hdr->byte_order != SDR_CACHE_BYTE_ORDER
+	    || hdr->hash_size != SDR_HASH_SIZE
+	    || (info
+		&& (memcmp(hdr->add_stamp,
+			   info->most_recent_addition_timestamp, 4)
+		    || memcmp(hdr->erase_stamp,
+			      info->most_recent_erase_timestamp, 4))))
+	{
+		lprintf(LOG_DEBUG, "SDR cache %s is stale", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	count = hdr->count;
+	if (hdr->size != (uint32_t)st.st_size
+	    || hdr->table % 4
+	    || hdr->table < sizeof (*hdr)
+	    || count > 0xffff
+	    || (uint64_t)hdr->table + 4 * (uint64_t)SDR_CACHE_TABLE_LEN(count)
+	       != hdr->size)
+		goto corrupted;
+
+	offset = (const uint32_t *)(map + hdr->table);
+	head = offset + count;
+	tail = head + SDR_INDEX_MAX * SDR_HASH_SIZE;
+	next = tail + SDR_INDEX_MAX * SDR_HASH_SIZE;
+
+	nodes = calloc(count ? count : 1, sizeof (struct sdr_record_list));
+	if (!nodes) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	for (n = 0; n < count; n++) {
+		uint8_t *rec = map + offset[n];
+
+		if (offset[n] < sizeof (*hdr)
+		    || (uint64_t)offset[n] + 5 > hdr->table
+		    || (uint64_t)offset[n] + 5 + rec[4] > hdr->table)
+			goto corrupted;
+
+		nodes[n].id = rec[0] | (rec[1] << 8);
+		nodes[n].version = rec[2];
+		nodes[n].type = rec[3];
+		nodes[n].length = rec[4];
+		nodes[n].record.common =
+			(struct sdr_record_common_sensor *)(rec + 5);
+		nodes[n].next = (n + 1 < count) ? &nodes[n + 1] : NULL;
+
+		/* chains only run forward, so they can not loop */
+		for (i = 0; i < SDR_INDEX_MAX; i++) {
+			v = next[i * count + n];
+			if (v && (v <= n + 1 || v > count))
+				goto corrupted;
+			nodes[n].hash_next[i] = v ? &nodes[v - 1] : NULL;
+		}
+	}
+
+	for (i = 0; i < SDR_INDEX_MAX; i++) {
+		for (b = 0; b < SDR_HASH_SIZE; b++) {
+			v = head[i * SDR_HASH_SIZE + b];
+			if (v > count)
+				goto corrupted;
+			sdr_hash[i][b].head = v ? &nodes[v - 1] : NULL;
+
+			v = tail[i * SDR_HASH_SIZE + b];
+			if (v > count)
+				goto corrupted;
+			sdr_hash[i][b].tail = v ? &nodes[v - 1].hash_next[i]
+						: NULL;
+		}
+	}
+
+	sdr_cache_map = map;
+	sdr_cache_map_len = st.st_size;
+	sdr_cache_nodes = nodes;
+	sdr_cache_count = count;
+	if (count) {
+		sdr_list_head = &nodes[0];
+		sdr_list_tail = &nodes[count - 1];
+	}
+
+	if (!sdr_list_itr) {
+		sdr_list_itr = malloc(sizeof (struct ipmi_sdr_iterator));
+		if (sdr_list_itr) {
+			sdr_list_itr->reservation = 0;
+			sdr_list_itr->total = count;
+			sdr_list_itr->next = 0xffff;
+			sdr_list_itr->use_built_in = 0;
+		}
+	}
+
+	lprintf(LOG_DEBUG, "Mapped SDR cache %s, %u records", path, count);
+	return 0;
+
+corrupted:
+	lprintf(LOG_WARN, "SDR cache %s is corrupted", path);
+	memset(sdr_hash, 0, sizeof (sdr_hash));
+	free(nodes);
+	munmap(map, st.st_size);
+	return -1;
+}
+
+/* __sdr_cache_save  -  write SDR list to cache file
+ *
+ * The file is written under a temporary name and renamed into place,
+ * so concurrent readers never see a partial cache.
+ *
+ * @path:	cache file name
+ * @info:	repository info the list was read under
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+__sdr_cache_save(const char *path, struct get_sdr_repository_info_rsp *info)
 {
+	struct sdr_cache_header hdr;
+	struct sdr_record_list *sdrr;
+	uint32_t *table, *offset, *head, *tail, *next;
+	uint32_t count = 0, pos, n, h;
+	int bucket[SDR_INDEX_MAX];
+	char tmp[PATH_MAX];
 	FILE *fp;
+	int i, rc = 0;
+
+	for (sdrr = sdr_list_head; sdrr; sdrr = sdrr->next)
+		count++;
+
+	table = calloc(SDR_CACHE_TABLE_LEN(count), sizeof (uint32_t));
+	if (!table) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+	offset = table;
+	head = offset + count;
+	tail = head + SDR_INDEX_MAX * SDR_HASH_SIZE;
+	next = tail + SDR_INDEX_MAX * SDR_HASH_SIZE;
+
+	/* lay out the records and replay the index chains */
+	pos = sizeof (hdr);
+	for (n = 0, sdrr = sdr_list_head; sdrr; n++, sdrr = sdrr->next) {
+		offset[n] = pos;
+		pos += 5 + sdrr->length;
+
+		__sdr_hash_buckets(sdrr, bucket);
+		for (i = 0; i < SDR_INDEX_MAX; i++) {
+			if (bucket[i] < 0)
+				continue;
+			h = i * SDR_HASH_SIZE + bucket[i];
+			if (head[h])
+				next[i * count + tail[h] - 1] = n + 1;
+			else
+				head[h] = n + 1;
+			tail[h] = n + 1;
+		}
+	}
+
+	memset(&hdr, 0, sizeof (hdr));
+	memcpy(hdr.magic, SDR_CACHE_MAGIC, sizeof (hdr.magic));
+	hdr.version = SDR_CACHE_VERSION;
+	memcpy(hdr.add_stamp, info->most_recent_addition_timestamp, 4);
+	memcpy(hdr.erase_stamp, info->most_recent_erase_timestamp, 4);
+	hdr.byte_order = SDR_CACHE_BYTE_ORDER;
+	hdr.count = count;
+	hdr.hash_size = SDR_HASH_SIZE;
+	hdr.table = (pos + 3) & ~3;
+	hdr.size = hdr.table + SDR_CACHE_TABLE_LEN(count) * sizeof (uint32_t);
+
+	if (snprintf(tmp, sizeof (tmp), "%s.%ld", path, (long)getpid())
+	    >= (int)sizeof (tmp))
+		fp = NULL;
+	else
+		fp = fopen(tmp, "w");
+	if (!fp) {
+		lperror(LOG_WARN, "Unable to write SDR cache %s", tmp);
+		free(table);
+		return -1;
+	}
+
+	if (fwrite(&hdr, 1, sizeof (hdr), fp) != sizeof (hdr))
+		rc = -1;
+
+	for (sdrr = sdr_list_head; sdrr && rc == 0; sdrr = sdrr->next) {
+		uint8_t h[5];
+
+		h[0] = sdrr->id & 0xff;
+		h[1] = (sdrr->id >> 8) & 0xff;
+		h[2] = sdrr->version;
+		h[3] = sdrr->type;
+		h[4] = sdrr->length;
+
+		if (fwrite(h, 1, 5, fp) != 5
+		    || fwrite(sdrr->record.common, 1, sdrr->length, fp)
+		       != sdrr->length)
+			rc = -1;
+	}
+
+	/* pad up to the tables */
+	for (; pos < hdr.table && rc == 0; pos++) {
+		if (fputc(0, fp) == EOF)
+			rc = -1;
+	}
+
+	if (rc == 0
+	    && fwrite(table, sizeof (uint32_t), SDR_CACHE_TABLE_LEN(count), fp)
+	       != SDR_CACHE_TABLE_LEN(count))
+		rc = -1;
+
+	free(table);
+	if (fclose(fp) != 0)
+		rc = -1;
+	if (rc == 0 && rename(tmp, path) < 0)
+		rc = -1;
+	if (rc < 0) {
+		lperror(LOG_WARN, "Unable to write SDR cache %s", path);
+		unlink(tmp);
+		return -1;
+	}
+
+	lprintf(LOG_DEBUG, "Saved SDR cache %s", path);
+	return 0;
+}
+
+/* __sdr_list_cache_fromfp  -  load SDR records in 'sdr dump' format
+ *
+ * @fp:		file positioned at the first record
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+__sdr_list_cache_fromfp(FILE *fp)
+{
 	struct __sdr_header {
 		uint16_t id;
 		uint8_t version;
@@ -4066,18 +5259,6 @@ ipmi_sdr_list_cache_fromfile(const char *ifile)
 	uint8_t *rec;
 	int ret = 0, count = 0, bc = 0;
 
-	if (!ifile) {
-		lprintf(LOG_ERR, "No SDR cache filename given");
-		return -1;
-	}
-
-	fp = ipmi_open_file_read(ifile);
-	if (!fp) {
-		lprintf(LOG_ERR, "Unable to open SDR cache %s for reading",
-			ifile);
-		return -1;
-	}
-
 	while (feof(fp) == 0) {
 		memset(&header, 0, sizeof(header));
 		bc = fread(&header, 1, 5, fp);
@@ -4112,7 +5293,9 @@ ipmi_sdr_list_cache_fromfile(const char *ifile)
 		memset(sdrr, 0, sizeof (struct sdr_record_list));
 
 		sdrr->id = header.id;
+		sdrr->version = header.version;
 		sdrr->type = header.type;
+		sdrr->length = header.length;
 
 		rec = malloc(header.length + 1);
 		if (!rec) {
@@ -4179,13 +5362,8 @@ ipmi_sdr_list_cache_fromfile(const char *ifile)
 			continue;
 		}
 
-		/* add to global record liset */
-		if (!sdr_list_head)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(sdrr);
 
 		count++;
 
@@ -4199,9 +5377,49 @@ ipmi_sdr_list_cache_fromfile(const char *ifile)
 			sdr_list_itr->reservation = 0;
 			sdr_list_itr->total = count;
 			sdr_list_itr->next = 0xffff;
+			sdr_list_itr->use_built_in = 0;
 		}
 	}
 
+	return ret;
+}
+
+/* ipmi_sdr_list_cache_fromfile  -  generate SDR cache for fast lookup from local file
+ *
+ * @ifile:	input filename
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+int
+ipmi_sdr_list_cache_fromfile(const char *ifile)
+{
+	char magic[4];
+	FILE *fp;
+	int ret;
+
+	if (!ifile) {
+		lprintf(LOG_ERR, "No SDR cache filename given");
+		return -1;
+	}
+
+	fp = ipmi_open_file_read(ifile);
+	if (!fp) {
+		lprintf(LOG_ERR, "Unable to open SDR cache %s for reading",
+			ifile);
+		return -1;
+	}
+
+	/* files of the automatic SDR cache are mapped in place */
+	if (fread(magic, 1, sizeof (magic), fp) == sizeof (magic)
+	    && !memcmp(magic, SDR_CACHE_MAGIC, sizeof (magic))) {
+		fclose(fp);
+		return __sdr_cache_map(ifile, NULL);
+	}
+	rewind(fp);
+
+	ret = __sdr_list_cache_fromfp(fp);
+
 	fclose(fp);
 	return ret;
 }
@@ -4217,6 +5435,7 @@ int
 ipmi_sdr_list_cache(struct ipmi_intf *intf)
 {
 	struct sdr_get_rs *header;
+	int rc = 0;
 
 	if (!sdr_list_itr) {
 		sdr_list_itr = ipmi_sdr_start(intf, 0);
@@ -4237,7 +5456,9 @@ ipmi_sdr_list_cache(struct ipmi_intf *intf)
 		}
 		memset(sdrr, 0, sizeof (struct sdr_record_list));
 		sdrr->id = header->id;
+		sdrr->version = header->version;
 		sdrr->type = header->type;
+		sdrr->length = header->length;
 
 		rec = ipmi_sdr_get_record(intf, header, sdr_list_itr);
 		if (!rec) {
@@ -4245,6 +5466,7 @@ ipmi_sdr_list_cache(struct ipmi_intf *intf)
 				free(sdrr);
 				sdrr = NULL;
 			}
+			rc = -1;
 			continue;
 		}
 
@@ -4284,18 +5506,100 @@ ipmi_sdr_list_cache(struct ipmi_intf *intf)
 			continue;
 		}
 
-		/* add to global record liset */
-		if (!sdr_list_head)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(sdrr);
 	}
 
+	return rc;
+}
+
+/*
+ * Automatic SDR cache
+ *
+ * When a cache directory is configured the first full walk of a BMC's
+ * SDR repository is saved to a file named after the BMC's identity.
+ * Later runs only ask for the repository info and map the file while
+ * its addition and erase timestamps are still those of the repository.
+ */
+static const char *sdr_cache_dir = NULL;
+
+/* ipmi_sdr_set_cache_dir  -  enable the automatic SDR cache
+ *
+ * @dir:	directory to keep cache files in, must stay valid
+ *		for the lifetime of the program; NULL disables the cache
+ */
+void
+ipmi_sdr_set_cache_dir(const char *dir)
+{
+	sdr_cache_dir = dir;
+}
+
+/* __sdr_cache_path  -  build the cache file name of a BMC
+ *
+ * The name is the identity of the BMC, see ipmi_mc_get_identity().
+ * BMCs that do not keep a SDR repository or do not report a usable GUID
+ * are not cached.
+ *
+ * @intf:	ipmi interface
+ * @path:	buffer for the file name
+ * @len:	size of buffer
+ *
+ * returns 0 on success
+ * returns -1 if the BMC can not be cached
+ */
+static int
+__sdr_cache_path(struct ipmi_intf *intf, char *path, size_t len)
+{
+	char name[64];
+	uint8_t support = 0;
+	int n;
+
+	if (ipmi_mc_get_identity(intf, name, sizeof (name), &support) < 0
+	    || !(support & 0x02))
+		return -1;
+
+	n = snprintf(path, len, "%s/%s.sdr", sdr_cache_dir, name);
+	if (n <= 0 || (size_t)n >= len)
+		return -1;
+
 	return 0;
 }
 
+/* __sdr_list_start  -  start filling the global SDR list
+ *
+ * Loads the list from the automatic SDR cache when there is a valid
+ * one.  On a cache miss the whole repository is read at once and saved
+ * for the next run.  Without a cache directory this is ipmi_sdr_start().
+ *
+ * @intf:	ipmi interface
+ *
+ * returns iterator for the global SDR list
+ * returns NULL on error
+ */
+static struct ipmi_sdr_iterator *
+__sdr_list_start(struct ipmi_intf *intf)
+{
+	struct get_sdr_repository_info_rsp info;
+	char path[PATH_MAX];
+
+	if (!sdr_cache_dir
+	    || __sdr_cache_path(intf, path, sizeof (path)) < 0
+	    || ipmi_sdr_get_info(intf, &info) != 0)
+		return ipmi_sdr_start(intf, 0);
+
+	if (__sdr_cache_map(path, &info) == 0)
+		return sdr_list_itr;
+
+	sdr_list_itr = ipmi_sdr_start(intf, 0);
+	if (!sdr_list_itr)
+		return NULL;
+
+	if (ipmi_sdr_list_cache(intf) == 0 && sdr_list_itr->next == 0xffff)
+		__sdr_cache_save(path, &info);
+
+	return sdr_list_itr;
+}
+
 /*
  * ipmi_sdr_get_info
  *
@@ -4499,12 +5803,8 @@ ipmi_sdr_dump_bin(struct ipmi_intf *intf, const char *ofile)
 		    return -1;
 		}
 
-		if (!sdr_list_head)
-			sdr_list_head = sdrr;
-		else
-			sdr_list_tail->next = sdrr;
-
-		sdr_list_tail = sdrr;
+		/* add to global record list */
+		__sdr_list_append(sdrr);
 	}
 
 	ipmi_sdr_end(itr);
@@ -38,6 +38,9 @@
 #include <ctype.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <ipmitool/helper.h>
 #include <ipmitool/log.h>
@@ -1623,9 +1626,19 @@ ipmi_sel_get_info(struct ipmi_intf * intf)
 	return 0;
 }
 
-uint16_t
-ipmi_sel_get_std_entry(struct ipmi_intf * intf, uint16_t id,
-		       struct sel_event_record * evt)
+/* __ipmi_sel_get_std_entry  -  read SEL entry without reporting errors
+ *
+ * @intf:	ipmi interface
+ * @id:		record ID to read
+ * @evt:	filled with the entry
+ * @ccode:	filled with the completion code, -1 if there was no response
+ *
+ * returns ID of the next entry
+ * returns 0 on error
+ */
+static uint16_t
+__ipmi_sel_get_std_entry(struct ipmi_intf * intf, uint16_t id,
+			 struct sel_event_record * evt, int * ccode)
 {
 	struct ipmi_rq req;
 	struct ipmi_rs * rsp;
@@ -1649,14 +1662,12 @@ ipmi_sel_get_std_entry(struct ipmi_intf * intf, uint16_t id,
 
 	rsp = intf->sendrecv(intf, &req);
 	if (!rsp) {
-		lprintf(LOG_ERR, "Get SEL Entry %x command failed", id);
+		*ccode = -1;
 		return 0;
 	}
-	if (rsp->ccode) {
-		lprintf(LOG_ERR, "Get SEL Entry %x command failed: %s",
-			id, val2str(rsp->ccode, completion_code_vals));
+	*ccode = rsp->ccode;
+	if (rsp->ccode)
 		return 0;
-	}
 
 	/* save next entry id */
 	next = (rsp->data[1] << 8) | rsp->data[0];
@@ -1730,6 +1741,26 @@ ipmi_sel_get_std_entry(struct ipmi_intf * intf, uint16_t id,
 	return next;
 }
 
+uint16_t
+ipmi_sel_get_std_entry(struct ipmi_intf * intf, uint16_t id,
+		       struct sel_event_record * evt)
+{
+	uint16_t next;
+	int ccode;
+
+	next = __ipmi_sel_get_std_entry(intf, id, evt, &ccode);
+	if (ccode < 0) {
+		lprintf(LOG_ERR, "Get SEL Entry %x command failed", id);
+		return 0;
+	}
+	if (ccode) {
+		lprintf(LOG_ERR, "Get SEL Entry %x command failed: %s",
+			id, val2str(ccode, completion_code_vals));
+		return 0;
+	}
+	return next;
+}
+
 static void
 ipmi_sel_print_event_file(struct ipmi_intf * intf, struct sel_event_record * evt, FILE * fp)
 {
@@ -2379,6 +2410,499 @@ ipmi_sel_save_entries(struct ipmi_intf * intf, int count, const char * savefile)
 	return __ipmi_sel_savelist_entries(intf, count, savefile, 0);
 }
 
+/*
+ * Incremental SEL listing
+ *
+ * A cursor file remembers the last entry shown and the SEL addition and
+ * erase timestamps at that time.  When both timestamps are unchanged
+ * there is nothing new and the SEL is not read at all.  Otherwise the
+ * remembered entry is read again: if it is still there the listing
+ * continues after it, if it is gone or was replaced the SEL has been
+ * cleared or has wrapped and the listing starts over.
+ */
+#define SEL_CURSOR_MAGIC	"ISEL"
+#define SEL_CURSOR_VERSION	1
+
+struct sel_cursor {
+	char magic[4];
+	uint8_t version;
+	uint8_t __reserved;
+	uint8_t last_id[2];	/* LS byte first */
+	uint8_t add_stamp[4];
+	uint8_t erase_stamp[4];
+	struct sel_event_record last;
+};
+
+/* ipmi_sel_list_new  -  list SEL entries added since the last call
+ *
+ * @intf:	ipmi interface
+ * @state:	cursor file, or directory to keep one cursor file per BMC in
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+ipmi_sel_list_new(struct ipmi_intf * intf, const char * state)
+{
+	struct ipmi_rs * rsp;
+	struct ipmi_rq req;
+	struct sel_cursor cur, old;
+	struct sel_event_record evt;
+	char path[PATH_MAX], tmp[PATH_MAX], name[64];
+	struct stat st;
+	uint16_t next_id = 0, curr_id;
+	int ccode, n = 0;
+	FILE * fp;
+
+	if (stat(state, &st) == 0 && S_ISDIR(st.st_mode)) {
+		if (ipmi_mc_get_identity(intf, name, sizeof(name), NULL) < 0) {
+			lprintf(LOG_ERR, "Unable to identify BMC, "
+				"use a cursor file instead of %s", state);
+			return -1;
+		}
+		snprintf(path, sizeof(path), "%s/%s.sel", state, name);
+	} else {
+		snprintf(path, sizeof(path), "%s", state);
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.msg.netfn = IPMI_NETFN_STORAGE;
+	req.msg.cmd = IPMI_CMD_GET_SEL_INFO;
+
+	rsp = intf->sendrecv(intf, &req);
+	if (!rsp) {
+		lprintf(LOG_ERR, "Get SEL Info command failed");
+		return -1;
+	}
+	if (rsp->ccode) {
+		lprintf(LOG_ERR, "Get SEL Info command failed: %s",
+		       val2str(rsp->ccode, completion_code_vals));
+		return -1;
+	}
+	if (rsp->data_len != 14) {
+		lprintf(LOG_ERR, "Get SEL Info command failed: "
+			"Invalid data length %d", rsp->data_len);
+		return -1;
+	}
+
+	memset(&cur, 0, sizeof(cur));
+	memcpy(cur.magic, SEL_CURSOR_MAGIC, sizeof(cur.magic));
+	cur.version = SEL_CURSOR_VERSION;
+	memcpy(cur.add_stamp, rsp->data + 5, 4);
+	memcpy(cur.erase_stamp, rsp->data + 9, 4);
+
+	memset(&old, 0, sizeof(old));
+	fp = fopen(path, "r");
+	if (fp) {
+		if (fread(&old, 1, sizeof(old), fp) != sizeof(old)
+		    || memcmp(old.magic, SEL_CURSOR_MAGIC, sizeof(old.magic))
+		    || old.version != SEL_CURSOR_VERSION) {
+			lprintf(LOG_WARN, "Ignoring invalid SEL cursor %s",
+				path);
+			memset(&old, 0, sizeof(old));
+		}
+		fclose(fp);
+	}
+
+	if (old.version) {
+		if (!memcmp(old.add_stamp, cur.add_stamp, 4)
+		    && !memcmp(old.erase_stamp, cur.erase_stamp, 4)) {
+			lprintf(LOG_DEBUG, "No new SEL entries");
+			return 0;
+		}
+
+		curr_id = old.last_id[0] | (old.last_id[1] << 8);
+		next_id = __ipmi_sel_get_std_entry(intf, curr_id, &evt,
+						   &ccode);
+		if (ccode < 0) {
+			lprintf(LOG_ERR, "Get SEL Entry %x command failed",
+				curr_id);
+			return -1;
+		}
+		if (ccode || next_id == 0
+		    || memcmp(&evt, &old.last, sizeof(evt))) {
+			lprintf(LOG_INFO, "SEL was cleared or has wrapped, "
+				"listing all entries");
+			next_id = 0;
+		} else {
+			cur.last_id[0] = old.last_id[0];
+			cur.last_id[1] = old.last_id[1];
+			cur.last = old.last;
+		}
+	}
+
+	while (next_id != 0xffff) {
+		curr_id = next_id;
+		lprintf(LOG_DEBUG, "SEL Next ID: %04x", curr_id);
+
+		next_id = ipmi_sel_get_std_entry(intf, curr_id, &evt);
+		if (next_id == 0) {
+			/*
+			 * usually next_id of zero means end but
+			 * retry because some hardware has quirks
+			 * and will return 0 randomly.
+			 */
+			next_id = ipmi_sel_get_std_entry(intf, curr_id, &evt);
+			if (next_id == 0)
+				break;
+		}
+
+		if (verbose)
+			ipmi_sel_print_std_entry_verbose(intf, &evt);
+		else
+			ipmi_sel_print_std_entry(intf, &evt);
+
+		cur.last_id[0] = evt.record_id & 0xff;
+		cur.last_id[1] = (evt.record_id >> 8) & 0xff;
+		cur.last = evt;
+		n++;
+	}
+
+	lprintf(LOG_DEBUG, "Listed %d new SEL entries", n);
+
+	/* replace the cursor in one step, concurrent runs see old or new */
+	if (snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid())
+	    >= (int)sizeof(tmp))
+		fp = NULL;
+	else
+		fp = fopen(tmp, "w");
+	if (!fp) {
+		lperror(LOG_ERR, "Unable to write SEL cursor %s", path);
+		return -1;
+	}
+	if (fwrite(&cur, 1, sizeof(cur), fp) != sizeof(cur)) {
+		fclose(fp);
+		fp = NULL;
+	}
+	if (!fp || fclose(fp) != 0 || rename(tmp, path) < 0) {
+		lperror(LOG_ERR, "Unable to write SEL cursor %s", path);
+		unlink(tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Bulk SEL export
+ *
+ * 'sel export' streams every SEL entry with the fields 'sel elist'
+ * decodes, either as one JSON object per line or in a binary stream.
+ * The binary stream starts with SEL_EXPORT_MAGIC and a version byte
+ * padded to 8 bytes.  Each event follows as a 2-byte length (LS byte
+ * first) of the rest of the event, the 16-byte SEL record as the BMC
+ * returned it, and the sensor name, sensor type and event description
+ * each as a 1-byte length and that many bytes.
+ *
+ * Sensor names and types are resolved once per sensor, not per event.
+ */
+#define SEL_EXPORT_MAGIC	"ISEV"
+#define SEL_EXPORT_VERSION	1
+#define SEL_EXPORT_HASH_SIZE	256
+
+enum {
+	SEL_EXPORT_JSON,
+	SEL_EXPORT_BINARY
+};
+
+struct sel_export_sensor {
+	struct sel_export_sensor * next;
+	uint16_t gen_id;
+	uint8_t num;
+	uint8_t type;
+	const char * type_name;
+	char name[17];
+};
+
+/* __sel_export_sensor  -  resolve sensor of SEL event once
+ *
+ * @intf:	ipmi interface
+ * @cache:	hash table of sensors resolved so far
+ * @evt:	standard SEL event
+ *
+ * returns sensor, NULL on malloc failure
+ */
+static struct sel_export_sensor *
+__sel_export_sensor(struct ipmi_intf * intf,
+		    struct sel_export_sensor ** cache,
+		    struct sel_event_record * evt)
+{
+	struct sel_export_sensor * s;
+	struct sdr_record_list * sdr;
+	uint16_t gen_id = evt->sel_type.standard_type.gen_id;
+	uint8_t num = evt->sel_type.standard_type.sensor_num;
+	uint8_t type = evt->sel_type.standard_type.sensor_type;
+	int hash = (gen_id * 31 + num * 7 + type) % SEL_EXPORT_HASH_SIZE;
+
+	for (s = cache[hash]; s; s = s->next) {
+		if (s->gen_id == gen_id && s->num == num && s->type == type)
+			return s;
+	}
+
+	s = malloc(sizeof(*s));
+	if (!s) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return NULL;
+	}
+	memset(s, 0, sizeof(*s));
+	s->gen_id = gen_id;
+	s->num = num;
+	s->type = type;
+	s->type_name = ipmi_get_sensor_type(intf, type);
+
+	sdr = ipmi_sdr_find_sdr_bynumtype(intf, gen_id, num, type);
+	if (ipmi_sdr_get_id_string(sdr, s->name, sizeof(s->name)) < 0)
+		s->name[0] = '\0';
+
+	s->next = cache[hash];
+	cache[hash] = s;
+	return s;
+}
+
+/* __sel_export_raw  -  rebuild the 16-byte SEL record of an event
+ *
+ * @evt:	SEL event
+ * @raw:	filled with the record as returned by Get SEL Entry
+ */
+static void
+__sel_export_raw(struct sel_event_record * evt, uint8_t * raw)
+{
+	uint32_t ts;
+	int i;
+
+	memset(raw, 0, 16);
+	raw[0] = evt->record_id & 0xff;
+	raw[1] = evt->record_id >> 8;
+	raw[2] = evt->record_type;
+
+	if (evt->record_type < 0xc0) {
+		ts = evt->sel_type.standard_type.timestamp;
+		raw[7] = evt->sel_type.standard_type.gen_id & 0xff;
+		raw[8] = evt->sel_type.standard_type.gen_id >> 8;
+		raw[9] = evt->sel_type.standard_type.evm_rev;
+		raw[10] = evt->sel_type.standard_type.sensor_type;
+		raw[11] = evt->sel_type.standard_type.sensor_num;
+		raw[12] = evt->sel_type.standard_type.event_type
+			  | (evt->sel_type.standard_type.event_dir << 7);
+		memcpy(raw + 13, evt->sel_type.standard_type.event_data, 3);
+	} else if (evt->record_type < 0xe0) {
+		ts = evt->sel_type.oem_ts_type.timestamp;
+		raw[7] = evt->sel_type.oem_ts_type.manf_id[2];
+		raw[8] = evt->sel_type.oem_ts_type.manf_id[1];
+		raw[9] = evt->sel_type.oem_ts_type.manf_id[0];
+		memcpy(raw + 10, evt->sel_type.oem_ts_type.oem_defined,
+		       SEL_OEM_TS_DATA_LEN);
+	} else {
+		memcpy(raw + 3, evt->sel_type.oem_nots_type.oem_defined,
+		       SEL_OEM_NOTS_DATA_LEN);
+		return;
+	}
+
+	for (i = 0; i < 4; i++)
+		raw[3 + i] = (ts >> (8 * i)) & 0xff;
+}
+
+/* __sel_export_json_string  -  write JSON string value */
+static void
+__sel_export_json_string(FILE * fp, const char * s)
+{
+	fputc('"', fp);
+	for (; s && *s; s++) {
+		unsigned char c = *s;
+
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20 || c >= 0x7f)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+	fputc('"', fp);
+}
+
+/* __sel_export_binary_string  -  write length-prefixed string */
+static void
+__sel_export_binary_string(FILE * fp, const char * s)
+{
+	size_t len = s ? __min(strlen(s), 0xff) : 0;
+
+	fputc(len, fp);
+	fwrite(s, 1, len, fp);
+}
+
+/* __sel_export_event  -  write one decoded SEL event
+ *
+ * @fp:		output stream
+ * @format:	SEL_EXPORT_JSON or SEL_EXPORT_BINARY
+ * @evt:	SEL event
+ * @sensor:	resolved sensor of a standard event, else NULL
+ * @desc:	event description, may be NULL
+ */
+static void
+__sel_export_event(FILE * fp, int format, struct sel_event_record * evt,
+		   struct sel_export_sensor * sensor, const char * desc)
+{
+	uint8_t raw[16];
+	size_t len;
+	int i;
+
+	if (format == SEL_EXPORT_BINARY) {
+		const char * name = sensor ? sensor->name : NULL;
+		const char * type = sensor ? sensor->type_name : NULL;
+
+		__sel_export_raw(evt, raw);
+		len = sizeof(raw) + 3;
+		len += name ? __min(strlen(name), 0xff) : 0;
+		len += type ? __min(strlen(type), 0xff) : 0;
+		len += desc ? __min(strlen(desc), 0xff) : 0;
+		fputc(len & 0xff, fp);
+		fputc(len >> 8, fp);
+		fwrite(raw, 1, sizeof(raw), fp);
+		__sel_export_binary_string(fp, name);
+		__sel_export_binary_string(fp, type);
+		__sel_export_binary_string(fp, desc);
+		return;
+	}
+
+	fprintf(fp, "{\"id\":%u,\"record_type\":%u",
+		evt->record_id, evt->record_type);
+
+	if (evt->record_type < 0xc0) {
+		fprintf(fp, ",\"timestamp\":%u,\"pre_init\":%s"
+			",\"generator\":%u,\"sensor_num\":%u"
+			",\"sensor_type_code\":%u,\"sensor_type\":",
+			evt->sel_type.standard_type.timestamp,
+			evt->sel_type.standard_type.timestamp < 0x20000000
+			? "true" : "false",
+			evt->sel_type.standard_type.gen_id,
+			evt->sel_type.standard_type.sensor_num,
+			evt->sel_type.standard_type.sensor_type);
+		__sel_export_json_string(fp, sensor ? sensor->type_name : NULL);
+		fprintf(fp, ",\"sensor\":");
+		__sel_export_json_string(fp, sensor ? sensor->name : NULL);
+		fprintf(fp, ",\"event_type\":%u,\"direction\":\"%s\""
+			",\"data\":[%u,%u,%u],\"description\":",
+			evt->sel_type.standard_type.event_type,
+			evt->sel_type.standard_type.event_dir
+			? "Deasserted" : "Asserted",
+			evt->sel_type.standard_type.event_data[0],
+			evt->sel_type.standard_type.event_data[1],
+			evt->sel_type.standard_type.event_data[2]);
+		__sel_export_json_string(fp, desc);
+	} else if (evt->record_type < 0xe0) {
+		fprintf(fp, ",\"timestamp\":%u,\"manufacturer\":%u"
+			",\"oem_data\":\"",
+			evt->sel_type.oem_ts_type.timestamp,
+			(evt->sel_type.oem_ts_type.manf_id[0] << 16)
+			| (evt->sel_type.oem_ts_type.manf_id[1] << 8)
+			| evt->sel_type.oem_ts_type.manf_id[2]);
+		for (i = 0; i < SEL_OEM_TS_DATA_LEN; i++)
+			fprintf(fp, "%02x",
+				evt->sel_type.oem_ts_type.oem_defined[i]);
+		fputc('"', fp);
+	} else {
+		fprintf(fp, ",\"oem_data\":\"");
+		for (i = 0; i < SEL_OEM_NOTS_DATA_LEN; i++)
+			fprintf(fp, "%02x",
+				evt->sel_type.oem_nots_type.oem_defined[i]);
+		fputc('"', fp);
+	}
+
+	fprintf(fp, "}\n");
+}
+
+/* ipmi_sel_export  -  stream all SEL entries in decoded form
+ *
+ * @intf:	ipmi interface
+ * @format:	SEL_EXPORT_JSON or SEL_EXPORT_BINARY
+ * @file:	output file name, "-" for standard output
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static int
+ipmi_sel_export(struct ipmi_intf * intf, int format, const char * file)
+{
+	struct sel_export_sensor * cache[SEL_EXPORT_HASH_SIZE];
+	struct sel_export_sensor * s, * sensor;
+	struct sel_event_record evt;
+	uint16_t next_id = 0, curr_id;
+	char * description;
+	FILE * fp;
+	int i, n = 0, rc = 0;
+
+	if (!strcmp(file, "-"))
+		fp = stdout;
+	else
+		fp = ipmi_open_file_write(file);
+	if (!fp)
+		return -1;
+
+	memset(cache, 0, sizeof(cache));
+
+	if (format == SEL_EXPORT_BINARY) {
+		uint8_t hdr[8];
+
+		memset(hdr, 0, sizeof(hdr));
+		memcpy(hdr, SEL_EXPORT_MAGIC, 4);
+		hdr[4] = SEL_EXPORT_VERSION;
+		fwrite(hdr, 1, sizeof(hdr), fp);
+	}
+
+	while (next_id != 0xffff) {
+		curr_id = next_id;
+		lprintf(LOG_DEBUG, "SEL Next ID: %04x", curr_id);
+
+		next_id = ipmi_sel_get_std_entry(intf, curr_id, &evt);
+		if (next_id == 0) {
+			/*
+			 * usually next_id of zero means end but
+			 * retry because some hardware has quirks
+			 * and will return 0 randomly.
+			 */
+			next_id = ipmi_sel_get_std_entry(intf, curr_id, &evt);
+			if (next_id == 0)
+				break;
+		}
+
+		sensor = NULL;
+		description = NULL;
+		if (evt.record_type < 0xc0) {
+			sensor = __sel_export_sensor(intf, cache, &evt);
+			if (!sensor) {
+				rc = -1;
+				break;
+			}
+			ipmi_get_event_desc(intf, &evt, &description);
+		}
+
+		__sel_export_event(fp, format, &evt, sensor, description);
+		free(description);
+		n++;
+	}
+
+	for (i = 0; i < SEL_EXPORT_HASH_SIZE; i++) {
+		for (s = cache[i]; s; s = sensor) {
+			sensor = s->next;
+			free(s);
+		}
+	}
+
+	if (fp == stdout) {
+		if (fflush(fp) != 0)
+			rc = -1;
+	} else if (fclose(fp) != 0) {
+		rc = -1;
+	}
+	if (rc < 0) {
+		lprintf(LOG_ERR, "SEL export to %s failed", file);
+		return -1;
+	}
+
+	lprintf(LOG_INFO, "Exported %d SEL entries", n);
+	return 0;
+}
+
 /*
  * ipmi_sel_interpret
  *
@@ -3009,7 +3533,7 @@ int ipmi_sel_main(struct ipmi_intf * intf, int argc, char ** argv)
 		rc = ipmi_sel_get_info(intf);
 	else if (!strcmp(argv[0], "help"))
 		lprintf(LOG_ERR, "SEL Commands:  "
-				"info clear delete list elist get add time save readraw writeraw interpret");
+				"info clear delete list elist get add time save export readraw writeraw interpret");
 	else if (!strcmp(argv[0], "interpret")) {
 		uint32_t iana = 0;
 		if (argc < 4) {
@@ -3032,6 +3556,22 @@ int ipmi_sel_main(struct ipmi_intf * intf, int argc, char ** argv)
 		}
 		rc = ipmi_sel_save_entries(intf, 0, argv[1]);
 	}
+	else if (!strcmp(argv[0], "export")) {
+		if (argc < 3) {
+			lprintf(LOG_NOTICE,
+				"usage: sel export <json|binary> <filename|->");
+			return 0;
+		}
+		if (!strcmp(argv[1], "json"))
+			rc = ipmi_sel_export(intf, SEL_EXPORT_JSON, argv[2]);
+		else if (!strcmp(argv[1], "binary"))
+			rc = ipmi_sel_export(intf, SEL_EXPORT_BINARY, argv[2]);
+		else {
+			lprintf(LOG_ERR, "Unknown SEL export format '%s'",
+				argv[1]);
+			rc = -1;
+		}
+	}
 	else if (!strcmp(argv[0], "add")) {
 		if (argc < 2) {
 			lprintf(LOG_NOTICE, "usage: sel add <filename>");
@@ -3069,6 +3609,7 @@ int ipmi_sel_main(struct ipmi_intf * intf, int argc, char ** argv)
 		 *	list           - show all SEL entries
 		 *  list first <n> - show the first (oldest) <n> SEL entries
 		 *  list last <n>  - show the last (newsest) <n> SEL entries
+		 *  list new <cursor> - show entries added since last time
 		 */
 		int count = 0;
 		int sign = 1;
@@ -3079,6 +3620,9 @@ int ipmi_sel_main(struct ipmi_intf * intf, int argc, char ** argv)
 		else
 			sel_extended = 0;
 
+		if (argc == 3 && !strcmp(argv[1], "new"))
+			return ipmi_sel_list_new(intf, argv[2]);
+
 		if (argc == 2) {
 			countstr = argv[1];
 		}
@@ -493,46 +493,36 @@ ipmi_sensor_print_fc(struct ipmi_intf *intf,
 static int
 ipmi_sensor_list(struct ipmi_intf *intf)
 {
-	struct sdr_get_rs *header;
-	struct ipmi_sdr_iterator *itr;
+	struct sensor_reading *sr;
+	int count = 0;
+	int i;
 	int rc = 0;
 
 	lprintf(LOG_DEBUG, "Querying SDR for sensor list");
 
-	itr = ipmi_sdr_start(intf, 0);
-	if (!itr) {
-		lprintf(LOG_ERR, "Unable to open SDR for reading");
+	/* read every sensor and its thresholds in one batch up front */
+	sr = ipmi_sdr_read_sensors(intf, NULL, &count, SDR_READ_THRESHOLDS, 3);
+	if (!sr)
 		return -1;
-	}
-
-	while ((header = ipmi_sdr_get_next_header(intf, itr))) {
-		uint8_t *rec;
-
-		rec = ipmi_sdr_get_record(intf, header, itr);
-		if (!rec) {
-			lprintf(LOG_DEBUG, "rec == NULL");
-			continue;
-		}
 
-		switch (header->type) {
-		case SDR_RECORD_TYPE_FULL_SENSOR:
-		case SDR_RECORD_TYPE_COMPACT_SENSOR:
+	ipmi_sdr_set_readings(sr, count);
+	for (i = 0; i < count; i++) {
+		if (sr[i].full)
 			ipmi_sensor_print_fc(intf,
-						   (struct
-						    sdr_record_common_sensor *)
-						   rec,
-						   header->type);
-			break;
-		}
-		free(rec);
-		rec = NULL;
+					     &sr[i].full->cmn,
+					     SDR_RECORD_TYPE_FULL_SENSOR);
+		else
+			ipmi_sensor_print_fc(intf,
+					     &sr[i].compact->cmn,
+					     SDR_RECORD_TYPE_COMPACT_SENSOR);
 
 		/* fix for CR6604909: */
 		/* mask failure of individual reads in sensor list command */
 		/* rc = (r == 0) ? rc : r; */
 	}
+	ipmi_sdr_set_readings(NULL, 0);
 
-	ipmi_sdr_end(itr);
+	free(sr);
 
 	return rc;
 }
@@ -0,0 +1,574 @@
+/*
+ * Copyright (c) 2026 The ipmitool project.  All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistribution of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistribution in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * Neither the name of the copyright holder, nor the names of
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * This software is provided "AS IS," without a warranty of any kind.
+ * ALL EXPRESS OR IMPLIED CONDITIONS, REPRESENTATIONS AND WARRANTIES,
+ * INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY, FITNESS FOR A
+ * PARTICULAR PURPOSE OR NON-INFRINGEMENT, ARE HEREBY EXCLUDED.
+ * THE COPYRIGHT HOLDER AND ITS LICENSORS SHALL NOT BE LIABLE
+ * FOR ANY DAMAGES SUFFERED BY LICENSEE AS A RESULT OF USING, MODIFYING
+ * OR DISTRIBUTING THIS SOFTWARE OR ITS DERIVATIVES.  IN NO EVENT WILL
+ * THE COPYRIGHT HOLDER OR ITS LICENSORS BE LIABLE FOR ANY LOST REVENUE,
+ * PROFIT OR DATA, OR FOR DIRECT, INDIRECT, SPECIAL, CONSEQUENTIAL,
+ * INCIDENTAL OR PUNITIVE DAMAGES, HOWEVER CAUSED AND REGARDLESS OF THE
+ * THEORY OF LIABILITY, ARISING OUT OF THE USE OF OR INABILITY TO USE THIS
+ * SOFTWARE, EVEN IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGES.
+ */
+
+/*
+ * Resident mode: 'ipmitool serve <socket>' keeps the interface, its
+ * session and the SDR list of the process alive and answers requests
+ * from local clients on a Unix stream socket, so monitoring agents do
+ * not pay for process start, session setup and an SDR walk per sample.
+ *
+ * Requests are handled one at a time over the single interface; a
+ * poll() loop multiplexes any number of clients up to
+ * IPMI_SERVE_CLIENTS_MAX.  Text requests run the regular command
+ * handlers with stdout and stderr captured, so clients get exactly what
+ * the command line would print.  See ipmi_serve.h for the protocol.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <ipmitool/helper.h>
+#include <ipmitool/log.h>
+#include <ipmitool/ipmi.h>
+#include <ipmitool/ipmi_intf.h>
+#include <ipmitool/ipmi_main.h>
+#include <ipmitool/ipmi_serve.h>
+
+struct serve_client {
+	int fd;			/* -1 for a free slot */
+	uint8_t * in;		/* received, not yet handled */
+	size_t in_len;
+	uint8_t * out;		/* responses not yet sent */
+	size_t out_len;
+	size_t out_sent;
+	size_t out_size;
+};
+
+/* 'fru' output by FRU id, the last entry for all FRUs */
+struct serve_fru {
+	time_t stamp;		/* 0 if nothing is cached */
+	uint8_t status;
+	uint8_t * text;
+	size_t len;
+};
+
+static struct serve_fru serve_fru_cache[257];
+static FILE * serve_output = NULL;
+static volatile sig_atomic_t serve_stop = 0;
+
+static void
+serve_catch_signal(int sig)
+{
+	serve_stop = sig;
+}
+
+/* serve_out_add  -  queue response bytes for a client
+ *
+ * returns 0 on success, -1 on malloc failure
+ */
+static int
+serve_out_add(struct serve_client * c, const void * data, size_t len)
+{
+	if (c->out_len + len > c->out_size) {
+		size_t size = c->out_size ? c->out_size : 4096;
+		uint8_t * tmp;
+
+		while (size < c->out_len + len)
+			size *= 2;
+		tmp = realloc(c->out, size);
+		if (!tmp) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return -1;
+		}
+		c->out = tmp;
+		c->out_size = size;
+	}
+	memcpy(c->out + c->out_len, data, len);
+	c->out_len += len;
+	return 0;
+}
+
+/* serve_reply  -  queue a complete response frame
+ *
+ * @c:		client
+ * @status:	IPMI_SERVE_STATUS_* code
+ * @data:	response data following the status
+ * @len:	length of data
+ */
+static int
+serve_reply(struct serve_client * c, uint8_t status,
+	    const void * data, size_t len)
+{
+	uint32_t hdr = htonl(len + 1);
+
+	if (serve_out_add(c, &hdr, sizeof(hdr)) < 0
+	    || serve_out_add(c, &status, 1) < 0
+	    || serve_out_add(c, data, len) < 0)
+		return -1;
+	return 0;
+}
+
+static int
+serve_reply_error(struct serve_client * c, const char * msg)
+{
+	return serve_reply(c, IPMI_SERVE_STATUS_BAD_REQUEST, msg, strlen(msg));
+}
+
+/* serve_run  -  run a command line with its output captured
+ *
+ * @intf:	ipmi interface
+ * @argc:	number of arguments
+ * @argv:	command and arguments
+ * @text:	set to malloc'ed output, NULL if there was none
+ * @len:	set to length of the output
+ *
+ * returns command result
+ */
+static int
+serve_run(struct ipmi_intf * intf, int argc, char ** argv,
+	  uint8_t ** text, size_t * len)
+{
+	int out = fileno(serve_output);
+	int saved[2];
+	off_t end;
+	int rc;
+
+	*text = NULL;
+	*len = 0;
+
+	if (ftruncate(out, 0) < 0 || lseek(out, 0, SEEK_SET) < 0)
+		return -1;
+
+	fflush(stdout);
+	fflush(stderr);
+	saved[0] = dup(STDOUT_FILENO);
+	saved[1] = dup(STDERR_FILENO);
+	dup2(out, STDOUT_FILENO);
+	dup2(out, STDERR_FILENO);
+
+	rc = ipmi_cmd_run(intf, argv[0], argc - 1, &argv[1]);
+
+	fflush(stdout);
+	fflush(stderr);
+	dup2(saved[0], STDOUT_FILENO);
+	dup2(saved[1], STDERR_FILENO);
+	close(saved[0]);
+	close(saved[1]);
+
+	end = lseek(out, 0, SEEK_CUR);
+	if (end <= 0)
+		return rc;
+
+	*text = malloc(end);
+	if (!*text) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+	if (pread(out, *text, end, 0) != end) {
+		free(*text);
+		*text = NULL;
+		return -1;
+	}
+	*len = end;
+	return rc;
+}
+
+/* serve_command  -  answer a request with the output of a command */
+static int
+serve_command(struct ipmi_intf * intf, struct serve_client * c,
+	      int argc, char ** argv)
+{
+	uint8_t * text;
+	size_t len;
+	int rc;
+
+	rc = serve_run(intf, argc, argv, &text, &len);
+	rc = serve_reply(c, rc ? IPMI_SERVE_STATUS_FAILED : IPMI_SERVE_STATUS_OK,
+			 text, len);
+	free(text);
+	return rc;
+}
+
+/* serve_fru  -  answer a 'fru' request, from memory while fresh */
+static int
+serve_fru(struct ipmi_intf * intf, struct serve_client * c,
+	  const uint8_t * data, size_t len)
+{
+	struct serve_fru * f;
+	char id[4];
+	char * argv[3] = { "fru", "print", id };
+	time_t now = time(NULL);
+	int rc;
+
+	if (len > 1)
+		return serve_reply_error(c, "Invalid FRU request");
+
+	f = &serve_fru_cache[len ? data[0] : 256];
+	if (!f->stamp || now - f->stamp >= IPMI_SERVE_FRU_TTL) {
+		free(f->text);
+		snprintf(id, sizeof(id), "%u", len ? data[0] : 0);
+		rc = serve_run(intf, len ? 3 : 2, argv, &f->text, &f->len);
+		f->status = rc ? IPMI_SERVE_STATUS_FAILED : IPMI_SERVE_STATUS_OK;
+		/* a failed read is not kept */
+		f->stamp = rc ? 0 : now;
+	}
+
+	return serve_reply(c, f->status, f->text, f->len);
+}
+
+/* serve_raw  -  pass a raw request to the BMC */
+static int
+serve_raw(struct ipmi_intf * intf, struct serve_client * c,
+	  const uint8_t * data, size_t len)
+{
+	struct ipmi_rq req;
+	struct ipmi_rs * rsp;
+	uint8_t reply[1 + IPMI_BUF_SIZE];
+
+	if (len < 2)
+		return serve_reply_error(c, "Invalid raw request");
+
+	memset(&req, 0, sizeof(req));
+	req.msg.netfn = data[0];
+	req.msg.cmd = data[1];
+	req.msg.data = (uint8_t *)data + 2;
+	req.msg.data_len = len - 2;
+
+	rsp = intf->sendrecv(intf, &req);
+	if (!rsp)
+		return serve_reply(c, IPMI_SERVE_STATUS_NO_RESPONSE, NULL, 0);
+
+	reply[0] = rsp->ccode;
+	len = rsp->data_len > 0 ? rsp->data_len : 0;
+	memcpy(reply + 1, rsp->data, len);
+	return serve_reply(c, IPMI_SERVE_STATUS_OK, reply, len + 1);
+}
+
+/* serve_request  -  handle one request body
+ *
+ * returns 0 on success, -1 if the client has to be dropped
+ */
+static int
+serve_request(struct ipmi_intf * intf, struct serve_client * c,
+	      uint8_t * body, size_t len)
+{
+	char * argv[64];
+	char * arg;
+	char * end;
+	int argc = 0;
+
+	switch (body[0]) {
+	case IPMI_SERVE_RAW:
+		return serve_raw(intf, c, body + 1, len - 1);
+	case IPMI_SERVE_SENSORS:
+		argv[argc++] = "sensor";
+		argv[argc++] = "list";
+		return serve_command(intf, c, argc, argv);
+	case IPMI_SERVE_FRU:
+		return serve_fru(intf, c, body + 1, len - 1);
+	case IPMI_SERVE_SEL_SINCE:
+		argv[argc++] = "sel";
+		argv[argc++] = "elist";
+		argv[argc++] = "new";
+		break;
+	case IPMI_SERVE_COMMAND:
+		break;
+	default:
+		return serve_reply_error(c, "Unknown request");
+	}
+
+	/* arguments, each terminated by '\0' */
+	if (len > 1 && body[len - 1] != '\0')
+		return serve_reply_error(c, "Unterminated argument");
+	end = (char *)body + len;
+	for (arg = (char *)body + 1; arg < end; arg += strlen(arg) + 1) {
+		if (argc == (int)ARRAY_SIZE(argv))
+			return serve_reply_error(c, "Too many arguments");
+		argv[argc++] = arg;
+	}
+
+	if (argc == 0 || (body[0] == IPMI_SERVE_SEL_SINCE && argc != 4))
+		return serve_reply_error(c, "Missing arguments");
+
+	/* nothing that would take over the server */
+	if (!strcmp(argv[0], "serve") || !strcmp(argv[0], "shell")
+	    || !strcmp(argv[0], "exec"))
+		return serve_reply_error(c, "Command not available");
+
+	return serve_command(intf, c, argc, argv);
+}
+
+/* serve_process  -  handle the complete requests a client sent
+ *
+ * Responses are only built while nothing is waiting to be sent, so a
+ * client which does not read does not make the server buffer without
+ * bounds.
+ */
+static int
+serve_process(struct ipmi_intf * intf, struct serve_client * c)
+{
+	uint32_t len;
+
+	while (c->out_sent == c->out_len && c->in_len >= sizeof(len)) {
+		memcpy(&len, c->in, sizeof(len));
+		len = ntohl(len);
+		if (len == 0 || len > IPMI_SERVE_REQUEST_MAX) {
+			lprintf(LOG_NOTICE, "serve: dropping client, bad frame");
+			return -1;
+		}
+		if (c->in_len < sizeof(len) + len)
+			break;
+
+		c->out_len = c->out_sent = 0;
+		if (serve_request(intf, c, c->in + sizeof(len), len) < 0)
+			return -1;
+
+		c->in_len -= sizeof(len) + len;
+		memmove(c->in, c->in + sizeof(len) + len, c->in_len);
+	}
+	return 0;
+}
+
+static void
+serve_drop(struct serve_client * c)
+{
+	close(c->fd);
+	free(c->in);
+	free(c->out);
+	memset(c, 0, sizeof(*c));
+	c->fd = -1;
+}
+
+/* serve_listen  -  create the listening socket
+ *
+ * A socket left behind by an earlier server is replaced.  The socket
+ * gives full access to the BMC session, so only the owner may use it.
+ */
+static int
+serve_listen(const char * path)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		lprintf(LOG_ERR, "Socket path %s too long", path);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		lperror(LOG_ERR, "socket");
+		return -1;
+	}
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+	    || chmod(path, 0600) < 0
+	    || listen(fd, IPMI_SERVE_CLIENTS_MAX) < 0) {
+		lperror(LOG_ERR, "Unable to listen on %s", path);
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	return fd;
+}
+
+static void
+ipmi_serve_usage(void)
+{
+	lprintf(LOG_NOTICE, "usage: serve <socket>");
+	lprintf(LOG_NOTICE, "");
+	lprintf(LOG_NOTICE, "   Answer requests from local clients on the Unix socket,");
+	lprintf(LOG_NOTICE, "   keeping the session and SDR list between requests.");
+	lprintf(LOG_NOTICE, "   Runs until interrupted.");
+}
+
+int
+ipmi_serve_main(struct ipmi_intf * intf, int argc, char ** argv)
+{
+	struct serve_client clients[IPMI_SERVE_CLIENTS_MAX];
+	struct serve_client * owner[IPMI_SERVE_CLIENTS_MAX + 1];
+	struct pollfd pfd[IPMI_SERVE_CLIENTS_MAX + 1];
+	struct sigaction sa, old_int, old_term;
+	time_t last = time(NULL);
+	int lfd, fd, i, n;
+	int rc = 0;
+
+	if (argc != 1 || !strcmp(argv[0], "help")) {
+		ipmi_serve_usage();
+		return argc == 1 ? 0 : -1;
+	}
+
+	serve_output = tmpfile();
+	if (!serve_output) {
+		lperror(LOG_ERR, "tmpfile");
+		return -1;
+	}
+
+	lfd = serve_listen(argv[0]);
+	if (lfd < 0) {
+		fclose(serve_output);
+		return -1;
+	}
+
+	for (i = 0; i < IPMI_SERVE_CLIENTS_MAX; i++) {
+		memset(&clients[i], 0, sizeof(clients[i]));
+		clients[i].fd = -1;
+	}
+
+	/* stop cleanly, so the session is closed or saved */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = serve_catch_signal;
+	sigaction(SIGINT, &sa, &old_int);
+	sigaction(SIGTERM, &sa, &old_term);
+	signal(SIGPIPE, SIG_IGN);
+
+	lprintf(LOG_NOTICE, "Serving requests on %s", argv[0]);
+
+	while (!serve_stop) {
+		n = 0;
+		pfd[n].fd = lfd;
+		pfd[n].events = POLLIN;
+		pfd[n].revents = 0;
+		owner[n++] = NULL;
+		for (i = 0; i < IPMI_SERVE_CLIENTS_MAX; i++) {
+			if (clients[i].fd < 0)
+				continue;
+			pfd[n].fd = clients[i].fd;
+			pfd[n].events = clients[i].out_sent < clients[i].out_len
+					? POLLOUT : POLLIN;
+			pfd[n].revents = 0;
+			owner[n++] = &clients[i];
+		}
+
+		i = poll(pfd, n, IPMI_SERVE_KEEPALIVE * 1000);
+		if (i < 0) {
+			if (errno == EINTR)
+				continue;
+			lperror(LOG_ERR, "poll");
+			rc = -1;
+			break;
+		}
+
+		/* keep the session from timing out between requests */
+		if (i == 0 || time(NULL) - last >= IPMI_SERVE_KEEPALIVE) {
+			if (intf->keepalive)
+				intf->keepalive(intf);
+			last = time(NULL);
+			if (i == 0)
+				continue;
+		}
+
+		if (pfd[0].revents) {
+			fd = accept(lfd, NULL, NULL);
+			for (i = 0; fd >= 0 && i < IPMI_SERVE_CLIENTS_MAX; i++) {
+				if (clients[i].fd < 0)
+					break;
+			}
+			if (fd >= 0 && i == IPMI_SERVE_CLIENTS_MAX) {
+				lprintf(LOG_NOTICE, "serve: too many clients");
+				close(fd);
+			} else if (fd >= 0) {
+				fcntl(fd, F_SETFL, O_NONBLOCK);
+				clients[i].fd = fd;
+			}
+		}
+
+		for (i = 1; i < n; i++) {
+			struct serve_client * c = owner[i];
+			ssize_t r;
+
+			if (!pfd[i].revents)
+				continue;
+
+			if (c->out_sent < c->out_len) {
+				r = write(c->fd, c->out + c->out_sent,
+					  c->out_len - c->out_sent);
+				if (r < 0 && (errno == EAGAIN || errno == EINTR))
+					continue;
+				if (r < 0) {
+					serve_drop(c);
+					continue;
+				}
+				c->out_sent += r;
+			} else {
+				uint8_t * tmp;
+
+				tmp = realloc(c->in, c->in_len + 4096);
+				if (!tmp) {
+					serve_drop(c);
+					continue;
+				}
+				c->in = tmp;
+				r = read(c->fd, c->in + c->in_len, 4096);
+				if (r < 0 && (errno == EAGAIN || errno == EINTR))
+					continue;
+				if (r <= 0) {
+					serve_drop(c);
+					continue;
+				}
+				c->in_len += r;
+				last = time(NULL);
+			}
+
+			if (serve_process(intf, c) < 0)
+				serve_drop(c);
+		}
+	}
+
+	for (i = 0; i < IPMI_SERVE_CLIENTS_MAX; i++) {
+		if (clients[i].fd >= 0)
+			serve_drop(&clients[i]);
+	}
+	for (i = 0; i < (int)ARRAY_SIZE(serve_fru_cache); i++) {
+		free(serve_fru_cache[i].text);
+		serve_fru_cache[i].text = NULL;
+		serve_fru_cache[i].stamp = 0;
+	}
+	close(lfd);
+	unlink(argv[0]);
+	fclose(serve_output);
+	serve_output = NULL;
+
+	sigaction(SIGINT, &old_int, NULL);
+	sigaction(SIGTERM, &old_term, NULL);
+	if (serve_stop)
+		lprintf(LOG_NOTICE, "Stopped serving requests on %s", argv[0]);
+	return rc;
+}
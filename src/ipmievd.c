@@ -37,9 +37,14 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <string.h>
+#include <stdarg.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <signal.h>
 
 #if defined(HAVE_CONFIG_H)
@@ -69,7 +74,6 @@
 # else
 #  include "plugins/open/open.h"
 # endif
-#  include <poll.h>
 #endif /* IPMI_INTF_OPEN */
 
 #include <ipmitool/helper.h>
@@ -82,9 +86,33 @@
 #include <ipmitool/ipmi_main.h>
 
 #define WARNING_THRESHOLD	80
+
+/*
+ * The SEL is polled again SELWATCH_INTERVAL_MIN milliseconds after it
+ * changed, and the interval doubles with every idle check up to the
+ * timeout= setting.  Once the SEL is SELWATCH_DRAIN_THRESHOLD percent
+ * full it is kept at the shortest interval so entries are picked up
+ * before the SEL overflows.
+ */
+#define SELWATCH_INTERVAL_MIN	1000
+#define SELWATCH_DRAIN_THRESHOLD	WARNING_THRESHOLD
 #define DEFAULT_PIDFILE		_PATH_VARRUN "ipmievd.pid"
 char pidfile[64];
 
+/*
+ * Events are queued as they are read and only decoded once the event
+ * source is drained, so a storm of events does not back up in the
+ * kernel or the SEL while the previous ones are being resolved.
+ * Decoding goes in slices of EVENT_DECODE_BATCH, so the source is
+ * drained again in between.
+ */
+#define EVENT_QUEUE_SIZE	4096
+#define EVENT_DECODE_BATCH	256
+
+/* Decoded event lines are collected and written out per batch */
+#define OUTPUT_SINKS_MAX	4
+#define OUTPUT_BATCH_SIZE	65536
+
 /* global variables */
 int verbose = 0;
 int csv_output = 0;
@@ -92,7 +120,31 @@ uint16_t selwatch_count = 0;	/* number of entries in the SEL */
 uint16_t selwatch_lastid = 0;	/* current last entry in the SEL */
 int selwatch_pctused = 0;	/* current percent usage in the SEL */
 int selwatch_overflow = 0;	/* SEL overflow */
-int selwatch_timeout = 10;	/* default to 10 seconds */
+uint32_t selwatch_addition = 0;	/* most recent addition timestamp */
+uint32_t selwatch_erase = 0;	/* most recent erase timestamp */
+int selwatch_timeout = 60;	/* longest interval, default to 60 seconds */
+int selwatch_interval = SELWATCH_INTERVAL_MIN;	/* next check, in ms */
+
+static struct sel_event_record event_queue[EVENT_QUEUE_SIZE];
+static int event_queue_head = 0;
+static int event_queue_len = 0;
+
+/* where decoded events go, syslog (or stderr) if none is given */
+enum {
+	OUTPUT_SYSLOG,
+	OUTPUT_FILE,
+	OUTPUT_SOCKET,
+};
+
+struct output_sink {
+	int type;
+	int fd;
+	struct sockaddr_un addr;	/* path of a file or socket */
+};
+static struct output_sink output_sinks[OUTPUT_SINKS_MAX];
+static int output_sink_count = 0;
+static char output_batch[OUTPUT_BATCH_SIZE];
+static size_t output_batch_len = 0;
 
 /* event interface definition */
 struct ipmi_event_intf {
@@ -112,40 +164,42 @@ typedef struct sel_data {
 	uint16_t entries;
 	int pctused;
 	int overflow;
+	uint32_t addition;
+	uint32_t erase;
 } sel_data;
 
 static void log_event(struct ipmi_event_intf * eintf, struct sel_event_record * evt);
+static void queue_event(struct ipmi_event_intf * eintf, struct sel_event_record * evt);
+static int ipmievd_wait(struct ipmi_event_intf * eintf);
 
 /* ~~~~~~~~~~~~~~~~~~~~~~ openipmi ~~~~~~~~~~~~~~~~~~~~ */
 #ifdef IPMI_INTF_OPEN
 static int openipmi_setup(struct ipmi_event_intf * eintf);
-static int openipmi_wait(struct ipmi_event_intf * eintf);
 static int openipmi_read(struct ipmi_event_intf * eintf);
 static struct ipmi_event_intf openipmi_event_intf = {
 	.name = "open",
 	.desc = "OpenIPMI asynchronous notification of events",
 	.prefix = "",
 	.setup = openipmi_setup,
-	.wait = openipmi_wait,
+	.wait = ipmievd_wait,
 	.read = openipmi_read,
-	.log = log_event,
+	.log = queue_event,
 };
 #endif
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /* ~~~~~~~~~~~~~~~~~~~~~~ selwatch ~~~~~~~~~~~~~~~~~~~~ */
 static int selwatch_setup(struct ipmi_event_intf * eintf);
-static int selwatch_wait(struct ipmi_event_intf * eintf);
 static int selwatch_read(struct ipmi_event_intf * eintf);
 static int selwatch_check(struct ipmi_event_intf * eintf);
 static struct ipmi_event_intf selwatch_event_intf = {
 	.name = "sel",
 	.desc = "Poll SEL for notification of events",
 	.setup = selwatch_setup,
-	.wait = selwatch_wait,
+	.wait = ipmievd_wait,
 	.read = selwatch_read,
 	.check = selwatch_check,
-	.log = log_event,
+	.log = queue_event,
 };
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -163,7 +217,10 @@ static void
 ipmievd_usage(void)
 {
 	lprintf(LOG_NOTICE, "Options:");
-	lprintf(LOG_NOTICE, "\ttimeout=#     Time between checks for SEL polling method [default=10]");
+	lprintf(LOG_NOTICE, "\ttimeout=#     Longest time between checks for SEL polling method [default=60]");
+	lprintf(LOG_NOTICE, "\toutput=sink   Write events to syslog, file:<path> or socket:<path>");
+	lprintf(LOG_NOTICE, "\t              instead of syslog, may be given up to %d times [default=syslog]",
+		OUTPUT_SINKS_MAX);
 	lprintf(LOG_NOTICE, "\tdaemon        Become a daemon [default]");
 	lprintf(LOG_NOTICE, "\tnodaemon      Do NOT become a daemon");
 }
@@ -200,6 +257,238 @@ ipmi_event_intf_load(char * name)
 	return NULL;
 }
 
+/* output_sink_open  -  open the file or socket of an output
+ *
+ * Done again once ipmievd has become a daemon, which closes all files.
+ *
+ * returns 0 on success, -1 on error
+ */
+static int
+output_sink_open(struct output_sink * s)
+{
+	switch (s->type) {
+	case OUTPUT_FILE:
+		s->fd = open(s->addr.sun_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if (s->fd < 0) {
+			lperror(LOG_ERR, "Unable to open %s", s->addr.sun_path);
+			return -1;
+		}
+		break;
+	case OUTPUT_SOCKET:
+		s->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+		if (s->fd < 0) {
+			lperror(LOG_ERR, "socket");
+			return -1;
+		}
+		break;
+	default:
+		s->fd = -1;
+		break;
+	}
+	return 0;
+}
+
+/* output_sink_add  -  add a destination for decoded events
+ *
+ * @spec:	"syslog", "file:<path>" or "socket:<path>"; a socket
+ *		is a Unix datagram socket receiving one datagram per batch
+ *
+ * returns 0 on success, -1 on error
+ */
+static int
+output_sink_add(const char * spec)
+{
+	struct output_sink * s;
+	const char * path = NULL;
+	char cwd[PATH_MAX];
+	int n;
+
+	if (output_sink_count == OUTPUT_SINKS_MAX) {
+		lprintf(LOG_ERR, "At most %d outputs may be given", OUTPUT_SINKS_MAX);
+		return -1;
+	}
+	s = &output_sinks[output_sink_count];
+	memset(s, 0, sizeof(*s));
+	s->addr.sun_family = AF_UNIX;
+
+	if (strcasecmp(spec, "syslog") == 0) {
+		s->type = OUTPUT_SYSLOG;
+	} else if (strncasecmp(spec, "file:", 5) == 0) {
+		s->type = OUTPUT_FILE;
+		path = spec + 5;
+	} else if (strncasecmp(spec, "socket:", 7) == 0) {
+		s->type = OUTPUT_SOCKET;
+		path = spec + 7;
+	} else {
+		lprintf(LOG_ERR, "Invalid output '%s'", spec);
+		return -1;
+	}
+
+	if (path) {
+		/* a daemon runs in /, keep relative paths where they were */
+		if (path[0] == '/' || !getcwd(cwd, sizeof(cwd)))
+			cwd[0] = '\0';
+		n = snprintf(s->addr.sun_path, sizeof(s->addr.sun_path), "%s%s%s",
+			     cwd, cwd[0] ? "/" : "", path);
+		if (!path[0] || n < 0 || n >= (int)sizeof(s->addr.sun_path)) {
+			lprintf(LOG_ERR, "Invalid output path '%s'", path);
+			return -1;
+		}
+	}
+
+	if (output_sink_open(s) < 0)
+		return -1;
+
+	output_sink_count++;
+	return 0;
+}
+
+/* ipmievd_flush  -  write out the collected event lines */
+static void
+ipmievd_flush(void)
+{
+	struct output_sink * s;
+	int i;
+
+	if (!output_batch_len)
+		return;
+
+	for (i = 0; i < output_sink_count; i++) {
+		s = &output_sinks[i];
+		if (s->fd < 0)
+			continue;
+		if (s->type == OUTPUT_SOCKET) {
+			/* nobody listening is not an error, the events are dropped */
+			if (sendto(s->fd, output_batch, output_batch_len, MSG_DONTWAIT,
+				   (struct sockaddr *)&s->addr, sizeof(s->addr)) < 0)
+				lprintf(LOG_DEBUG, "Unable to send events to %s: %s",
+					s->addr.sun_path, strerror(errno));
+		} else if (write(s->fd, output_batch, output_batch_len) < 0) {
+			lperror(LOG_ERR, "Unable to write events");
+		}
+	}
+	output_batch_len = 0;
+}
+
+/* ipmievd_output  -  emit one decoded event line */
+static void
+ipmievd_output(int level, const char * format, ...)
+{
+	char line[1024];
+	va_list vptr;
+	int i, n;
+
+	va_start(vptr, format);
+	n = vsnprintf(line, sizeof(line), format, vptr);
+	va_end(vptr);
+	if (n < 0)
+		return;
+	if (n >= (int)sizeof(line))
+		n = sizeof(line) - 1;
+
+	if (!output_sink_count) {
+		lprintf(level, "%s", line);
+		return;
+	}
+
+	for (i = 0; i < output_sink_count; i++) {
+		if (output_sinks[i].type == OUTPUT_SYSLOG)
+			lprintf(level, "%s", line);
+	}
+
+	if (output_batch_len + n + 1 > sizeof(output_batch))
+		ipmievd_flush();
+	memcpy(output_batch + output_batch_len, line, n);
+	output_batch_len += n;
+	output_batch[output_batch_len++] = '\n';
+}
+
+/* ipmievd_dispatch  -  decode queued events
+ *
+ * @eintf:	event interface
+ * @count:	maximum number of events to decode
+ */
+static void
+ipmievd_dispatch(struct ipmi_event_intf * eintf, int count)
+{
+	while (event_queue_len > 0 && count-- > 0) {
+		log_event(eintf, &event_queue[event_queue_head]);
+		event_queue_head = (event_queue_head + 1) % EVENT_QUEUE_SIZE;
+		event_queue_len--;
+	}
+	ipmievd_flush();
+}
+
+/* queue_event  -  keep an event for decoding once the source is drained */
+static void
+queue_event(struct ipmi_event_intf * eintf, struct sel_event_record * evt)
+{
+	if (!evt)
+		return;
+
+	/* a full queue is decoded rather than dropped */
+	if (event_queue_len == EVENT_QUEUE_SIZE)
+		ipmievd_dispatch(eintf, EVENT_DECODE_BATCH);
+
+	memcpy(&event_queue[(event_queue_head + event_queue_len) % EVENT_QUEUE_SIZE],
+	       evt, sizeof(*evt));
+	event_queue_len++;
+}
+
+/* ipmievd_wait  -  event loop
+ *
+ * Interfaces with a check routine are polled every selwatch_interval
+ * milliseconds, the others signal events on the interface fd.  Whatever
+ * arrived is read in full before any of it is decoded.
+ */
+static int
+ipmievd_wait(struct ipmi_event_intf * eintf)
+{
+	struct pollfd pfd;
+	int nfds = 0;
+	int timeout, backlog;
+	int r;
+
+	if (!eintf->check) {
+		pfd.fd = eintf->intf->fd;
+		pfd.events = POLLIN;
+		nfds = 1;
+	}
+
+	for (;;) {
+		/* go on decoding right away if there is a backlog */
+		backlog = event_queue_len > 0;
+		if (backlog)
+			timeout = 0;
+		else if (eintf->check)
+			timeout = selwatch_interval;
+		else
+			timeout = -1;
+
+		pfd.revents = 0;
+		r = poll(&pfd, nfds, timeout);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			lperror(LOG_CRIT, "Unable to wait for events");
+			return -1;
+		}
+
+		if (nfds && (pfd.revents & POLLIN)) {
+			eintf->read(eintf);
+		} else if (eintf->check && !backlog) {
+			if (eintf->check(eintf) > 0) {
+				lprintf(LOG_DEBUG, "New Events");
+				eintf->read(eintf);
+			}
+		}
+
+		ipmievd_dispatch(eintf, EVENT_DECODE_BATCH);
+	}
+
+	return 0;
+}
+
 static int
 compute_pctfull(uint16_t entries, uint16_t freespace)
 {
@@ -228,12 +517,12 @@ log_event(struct ipmi_event_intf * eintf, struct sel_event_record * evt)
 		return;
 
 	if (evt->record_type == 0xf0) {
-		lprintf(LOG_ALERT, "%sLinux kernel panic: %.11s",
+		ipmievd_output(LOG_ALERT, "%sLinux kernel panic: %.11s",
 			eintf->prefix, (char *) evt + 5);
 		return;
 	}
 	else if (evt->record_type >= 0xc0) {
-		lprintf(LOG_NOTICE, "%sIPMI Event OEM Record %02x",
+		ipmievd_output(LOG_NOTICE, "%sIPMI Event OEM Record %02x",
 			eintf->prefix, evt->record_type);
 		return;
 	}
@@ -248,12 +537,12 @@ log_event(struct ipmi_event_intf * eintf, struct sel_event_record * evt)
 	if (!sdr) {
 		/* could not find matching SDR record */
 		if (desc) {
-			lprintf(LOG_NOTICE, "%s%s sensor - %s",
+			ipmievd_output(LOG_NOTICE, "%s%s sensor - %s",
 				eintf->prefix, type, desc);
 			free(desc);
 			desc = NULL;
 		} else {
-			lprintf(LOG_NOTICE, "%s%s sensor %02x",
+			ipmievd_output(LOG_NOTICE, "%s%s sensor %02x",
 				eintf->prefix, type,
 				evt->sel_type.standard_type.sensor_num);
 		}
@@ -279,7 +568,7 @@ log_event(struct ipmi_event_intf * eintf, struct sel_event_record * evt)
 					sdr->record.full, evt->sel_type.standard_type.event_data[2]);
 			}
 
-			lprintf(LOG_NOTICE, "%s%s sensor %s %s %s (Reading %.*f %s Threshold %.*f %s)",
+			ipmievd_output(LOG_NOTICE, "%s%s sensor %s %s %s (Reading %.*f %s Threshold %.*f %s)",
 				eintf->prefix,
 				type,
 				sdr->record.full->id_string,
@@ -301,7 +590,7 @@ log_event(struct ipmi_event_intf * eintf, struct sel_event_record * evt)
 			/*
 			 * Discrete Event
 			 */
-			lprintf(LOG_NOTICE, "%s%s sensor %s %s %s",
+			ipmievd_output(LOG_NOTICE, "%s%s sensor %s %s %s",
 				eintf->prefix, type,
 				sdr->record.full->id_string, desc ? desc : "",
 				(evt->sel_type.standard_type.event_dir
@@ -314,7 +603,7 @@ log_event(struct ipmi_event_intf * eintf, struct sel_event_record * evt)
 			/*
 			 * OEM Event
 			 */
-			lprintf(LOG_NOTICE, "%s%s sensor %s %s %s",
+			ipmievd_output(LOG_NOTICE, "%s%s sensor %s %s %s",
 				eintf->prefix, type,
 				sdr->record.full->id_string, desc ? desc : "",
 				(evt->sel_type.standard_type.event_dir
@@ -323,7 +612,7 @@ log_event(struct ipmi_event_intf * eintf, struct sel_event_record * evt)
 		break;
 
 	case SDR_RECORD_TYPE_COMPACT_SENSOR:
-		lprintf(LOG_NOTICE, "%s%s sensor %s - %s %s",
+		ipmievd_output(LOG_NOTICE, "%s%s sensor %s - %s %s",
 			eintf->prefix, type,
 			sdr->record.compact->id_string, desc ? desc : "",
 			(evt->sel_type.standard_type.event_dir
@@ -331,7 +620,7 @@ log_event(struct ipmi_event_intf * eintf, struct sel_event_record * evt)
 		break;
 
 	default:
-		lprintf(LOG_NOTICE, "%s%s sensor (0x%02x) - %s",
+		ipmievd_output(LOG_NOTICE, "%s%s sensor (0x%02x) - %s",
 			eintf->prefix, type,
 			evt->sel_type.standard_type.sensor_num, desc ? desc : "");
 		break;
@@ -418,8 +707,13 @@ openipmi_setup(struct ipmi_event_intf * eintf)
 	return 0;
 }
 
+/* openipmi_read_one  -  receive one queued message
+ *
+ * returns 1 if a message was received, 0 if the queue is empty
+ * returns -1 on error
+ */
 static int
-openipmi_read(struct ipmi_event_intf * eintf)
+openipmi_read_one(struct ipmi_event_intf * eintf)
 {
 	struct ipmi_addr addr;
 	struct ipmi_recv recv;
@@ -435,7 +729,8 @@ openipmi_read(struct ipmi_event_intf * eintf)
 	if (rv < 0) {
 		switch (errno) {
 		case EINTR:
-			return 0; /* abort */
+		case EAGAIN:
+			return 0; /* abort, or nothing left */
 		case EMSGSIZE:
 			recv.msg.data_len = sizeof(data); /* truncated */
 			break;
@@ -447,11 +742,11 @@ openipmi_read(struct ipmi_event_intf * eintf)
 
 	if (!recv.msg.data || recv.msg.data_len == 0) {
 		lprintf(LOG_ERR, "No data in event");
-		return -1;
+		return 1;
 	}
 	if (recv.recv_type != IPMI_ASYNC_EVENT_RECV_TYPE) {
 		lprintf(LOG_ERR, "Type %x is not an event", recv.recv_type);
-		return -1;
+		return 1;
 	}
 
 	lprintf(LOG_DEBUG, "netfn:%x cmd:%x ccode:%d",
@@ -459,34 +754,18 @@ openipmi_read(struct ipmi_event_intf * eintf)
 
 	eintf->log(eintf, (struct sel_event_record *)recv.msg.data);
 
-	return 0;
+	return 1;
 }
 
+/* openipmi_read  -  receive every event queued by the driver */
 static int
-openipmi_wait(struct ipmi_event_intf * eintf)
+openipmi_read(struct ipmi_event_intf * eintf)
 {
-	struct pollfd pfd;
 	int r;
 
-	for (;;) {
-		pfd.fd = eintf->intf->fd; /* wait on openipmi device */
-		pfd.events = POLLIN;      /* wait for input */
-		r = poll(&pfd, 1, -1);
-
-		switch (r) {
-		case 0:
-			/* timeout is disabled */
-			break;
-		case -1:
-			lperror(LOG_CRIT, "Unable to read from IPMI device");
-			return -1;
-		default:
-			if (pfd.revents & POLLIN)
-				eintf->read(eintf);
-		}
-	}
-
-	return 0;
+	while ((r = openipmi_read_one(eintf)) > 0)
+		;
+	return r;
 }
 #endif /* IPMI_INTF_OPEN */
 /*************************************************************************/
@@ -521,11 +800,15 @@ selwatch_get_data(struct ipmi_intf * intf, struct sel_data *data)
 	data->entries  = buf2short(rsp->data + 1);
 	data->pctused  = compute_pctfull (data->entries, freespace);
     data->overflow = rsp->data[13] & 0x80;
+	data->addition = buf2long(rsp->data + 5);
+	data->erase = buf2long(rsp->data + 9);
 
 	lprintf(LOG_DEBUG, "SEL count is %d", data->entries);
 	lprintf(LOG_DEBUG, "SEL freespace is %d", freespace);
 	lprintf(LOG_DEBUG, "SEL Percent Used: %d%%\n", data->pctused);
 	lprintf(LOG_DEBUG, "SEL Overflow: %s", data->overflow ? "true" : "false");
+	lprintf(LOG_DEBUG, "SEL Last Add Time: %08x", data->addition);
+	lprintf(LOG_DEBUG, "SEL Last Del Time: %08x", data->erase);
 
 	return 1;
 }
@@ -564,6 +847,27 @@ selwatch_get_lastid(struct ipmi_intf * intf)
 	return curr_id;
 }
 
+/* selwatch_schedule  -  pick the interval until the next SEL check
+ *
+ * @changed:	whether the last check found the SEL changed
+ */
+static void
+selwatch_schedule(int changed)
+{
+	int longest = selwatch_timeout * 1000;
+
+	if (changed || (selwatch_pctused >= SELWATCH_DRAIN_THRESHOLD
+			&& !selwatch_overflow))
+		selwatch_interval = SELWATCH_INTERVAL_MIN;
+	else if (selwatch_interval < longest)
+		selwatch_interval *= 2;
+
+	if (selwatch_interval > longest)
+		selwatch_interval = longest;
+
+	lprintf(LOG_DEBUG, "Next SEL check in %d ms", selwatch_interval);
+}
+
 static int
 selwatch_setup(struct ipmi_event_intf * eintf)
 {
@@ -574,6 +878,9 @@ selwatch_setup(struct ipmi_event_intf * eintf)
 		selwatch_count = data.entries;
 		selwatch_pctused = data.pctused;
 		selwatch_overflow = data.overflow;
+		selwatch_addition = data.addition;
+		selwatch_erase = data.erase;
+		selwatch_schedule(0);
 		lprintf(LOG_DEBUG, "Current SEL count is %d", selwatch_count);
 		/* save current last record ID */
 		selwatch_lastid = selwatch_get_lastid(eintf->intf);
@@ -595,8 +902,10 @@ selwatch_setup(struct ipmi_event_intf * eintf)
 
 /* selwatch_check  -  check for waiting events
  *
- * this is done by reading sel info and comparing
- * the sel count value to what we currently know
+ * this is done by reading sel info and comparing the
+ * addition and erase timestamps and the sel count value
+ * to what we currently know, so the sel itself is only
+ * read when something was logged
  */
 static int
 selwatch_check(struct ipmi_event_intf * eintf)
@@ -605,11 +914,15 @@ selwatch_check(struct ipmi_event_intf * eintf)
 	int old_pctused = selwatch_pctused;
 	int old_overflow = selwatch_overflow;
 	struct sel_data data;
+	int changed = 0;
 
 	if (selwatch_get_data(eintf->intf, &data)) {
+		changed = (data.addition != selwatch_addition
+			   || data.entries > old_count);
 		selwatch_count = data.entries;
 		selwatch_pctused = data.pctused;
 		selwatch_overflow = data.overflow;
+		selwatch_addition = data.addition;
 		if (old_overflow && !selwatch_overflow) {
 			lprintf(LOG_NOTICE, "SEL overflow is cleared");
 		} else if (!old_overflow && selwatch_overflow) {
@@ -621,12 +934,20 @@ selwatch_check(struct ipmi_event_intf * eintf)
 		if (selwatch_count == 0) {
 			lprintf(LOG_DEBUG, "SEL count is 0 (old=%d), resetting lastid to 0", old_count);
 			selwatch_lastid = 0;
+		} else if (data.erase != selwatch_erase) {
+			/* everything left was logged after the clear */
+			lprintf(LOG_DEBUG, "SEL was cleared, resetting lastid to 0");
+			selwatch_lastid = 0;
+			changed = 1;
 		} else if (selwatch_count < old_count) {
 			selwatch_lastid = selwatch_get_lastid(eintf->intf);
 			lprintf(LOG_DEBUG, "SEL count lowered, new SEL lastid is %04x", selwatch_lastid);
 		}
+		selwatch_erase = data.erase;
 	}
-	return (selwatch_count > old_count);
+	changed = changed && selwatch_count > 0;
+	selwatch_schedule(changed);
+	return changed;
 }
 
 static int
@@ -667,18 +988,6 @@ selwatch_read(struct ipmi_event_intf * eintf)
 	return 0;
 }
 
-static int
-selwatch_wait(struct ipmi_event_intf * eintf)
-{
-	for (;;) {
-		if (eintf->check(eintf) > 0) {
-			lprintf(LOG_DEBUG, "New Events");
-			eintf->read(eintf);
-		}
-		sleep(selwatch_timeout);
-	}
-	return 0;
-}
 /*************************************************************************/
 
 static void
@@ -715,7 +1024,7 @@ ipmievd_main(struct ipmi_event_intf * eintf, int argc, char ** argv)
 		else if (strcasecmp(argv[i], "nodaemon") == 0) {
 			daemon = 0;
 		}
-		else if (strcasecmp(argv[i], "daemon=") == 0) {
+		else if (strncasecmp(argv[i], "daemon=", 7) == 0) {
 			if (strcasecmp(argv[i]+7, "on") == 0 ||
 			    strcasecmp(argv[i]+7, "yes") == 0)
 				daemon = 1;
@@ -723,18 +1032,22 @@ ipmievd_main(struct ipmi_event_intf * eintf, int argc, char ** argv)
 				 strcasecmp(argv[i]+7, "no") == 0)
 				daemon = 0;
 		}
-		else if (strcasecmp(argv[i], "timeout=") == 0) {
+		else if (strncasecmp(argv[i], "timeout=", 8) == 0) {
 			if ( (str2int(argv[i]+8, &selwatch_timeout) != 0) || 
 					selwatch_timeout < 0) {
 				lprintf(LOG_ERR, "Invalid input given or out of range for time-out.");
 				return (-1);
 			}
 		}
-		else if (strcasecmp(argv[i], "pidfile=") == 0) {
+		else if (strncasecmp(argv[i], "pidfile=", 8) == 0) {
 			memset(pidfile, 0, 64);
 			strncpy(pidfile, argv[i]+8,
 				__min(strlen((const char *)(argv[i]+8)), 63));
 		}
+		else if (strncasecmp(argv[i], "output=", 7) == 0) {
+			if (output_sink_add(argv[i]+7) < 0)
+				return (-1);
+		}
 	}
 
 	lprintf(LOG_DEBUG, "ipmievd: using pidfile %s", pidfile);
@@ -775,6 +1088,11 @@ ipmievd_main(struct ipmi_event_intf * eintf, int argc, char ** argv)
 		}
 		fprintf(fp, "%d\n", (int)getpid());
 		fclose(fp);
+
+		for (i = 0; i < output_sink_count; i++) {
+			if (output_sink_open(&output_sinks[i]) < 0)
+				exit(EXIT_FAILURE);
+		}
 	}
 
 	/* register signal handler for cleanup */
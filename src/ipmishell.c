@@ -36,6 +36,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include <ipmitool/helper.h>
 #include <ipmitool/log.h>
@@ -400,17 +404,551 @@ int ipmi_set_main(struct ipmi_intf * intf, int argc, char ** argv)
 	return 0;
 }
 
+/* exec_free_args  -  free an argument list built by exec_parse_line */
+static void
+exec_free_args(int __argc, char ** __argv)
+{
+	int i;
+
+	for (i=0; i<__argc; i++) {
+		if (__argv[i]) {
+			free(__argv[i]);
+			__argv[i] = NULL;
+		}
+	}
+}
+
+/* exec_parse_line  -  split a line of a command file into arguments
+ *
+ * @buf:	line, modified in place
+ * @__argv:	filled with EXEC_ARG_SIZE malloc'ed arguments at most
+ *
+ * returns number of arguments, 0 for an empty line
+ * returns -1 on malloc failure
+ */
+static int
+exec_parse_line(char * buf, char ** __argv)
+{
+	char * ptr, * tok, * tmp;
+	int __argc;
+
+	/* clip off optional comment tail indicated by # */
+	ptr = strchr(buf, '#');
+	if (ptr)
+		*ptr = '\0';
+	else
+		ptr = buf + strlen(buf);
+
+	/* change "" and '' with spaces in the middle to ~ */
+	ptr = buf;
+	while (*ptr != '\0') {
+		if (*ptr == '"') {
+			ptr++;
+			while (*ptr != '"' && *ptr != '\0') {
+				if (isspace((int)*ptr))
+					*ptr = '~';
+				ptr++;
+			}
+		}
+		if (*ptr == '\'') {
+			ptr++;
+			while (*ptr != '\'' && *ptr != '\0') {
+				if (isspace((int)*ptr))
+					*ptr = '~';
+				ptr++;
+			}
+		}
+		ptr++;
+	}
+
+	/* clip off trailing and leading whitespace */
+	ptr--;
+	while (isspace((int)*ptr) && ptr >= buf)
+		*ptr-- = '\0';
+	ptr = buf;
+	while (isspace((int)*ptr))
+		ptr++;
+	if (strlen(ptr) == 0)
+		return 0;
+
+	/* parse it and make argument list */
+	__argc = 0;
+	for (tok = strtok(ptr, " "); tok; tok = strtok(NULL, " ")) {
+		if (__argc < EXEC_ARG_SIZE) {
+			__argv[__argc++] = strdup(tok);
+			if (!__argv[__argc-1]) {
+				lprintf(LOG_ERR, "ipmitool: malloc failure");
+				exec_free_args(__argc - 1, __argv);
+				return -1;
+			}
+			tmp = __argv[__argc-1];
+			if (*tmp == '\'') {
+				memmove(tmp, tmp+1, strlen(tmp));
+				while (*tmp != '\'' && *tmp != '\0') {
+					if (*tmp == '~')
+						*tmp = ' ';
+					tmp++;
+				}
+				*tmp = '\0';
+			}
+			if (*tmp == '"') {
+				memmove(tmp, tmp+1, strlen(tmp));
+				while (*tmp != '"' && *tmp != '\0') {
+					if (*tmp == '~')
+						*tmp = ' ';
+					tmp++;
+				}
+				*tmp = '\0';
+			}
+		}
+	}
+	return __argc;
+}
+
+/* exec_is_wait  -  check for a "wait" line
+ *
+ * Running sequentially every command waits for the one before it, so
+ * the line is only meaningful to parallel execution.
+ */
+static int
+exec_is_wait(int __argc, char ** __argv)
+{
+	return __argc == 1 && strcmp(__argv[0], "wait") == 0;
+}
+
+/*
+ * Parallel exec.  With "jobs" the commands of a file are taken to be
+ * independent of each other and handed out to a number of forked
+ * workers, each with a session of its own.  Every worker captures the
+ * output of a command and sends it back, and the output is printed in
+ * file order, so it reads as if the commands had run one after another.
+ * A "wait" line lets all earlier commands finish before any later one
+ * is started.
+ */
+#define EXEC_JOBS_MAX	64
+
+enum {
+	EXEC_CMD_NEW,
+	EXEC_CMD_RUNNING,
+	EXEC_CMD_DONE,
+};
+
+struct exec_cmd {
+	int argc;		/* 0 for a "wait" line */
+	char * argv[EXEC_ARG_SIZE];
+	int state;
+	int rc;
+	char * out[2];		/* captured stdout and stderr */
+	size_t len[2];
+};
+
+struct exec_result {
+	int index;
+	int rc;
+	size_t len[2];
+};
+
+struct exec_worker {
+	pid_t pid;
+	int cmd_fd;		/* command indexes to the worker */
+	int res_fd;		/* results from the worker */
+	int busy;		/* command being run, -1 if idle */
+};
+
+static int
+exec_read_full(int fd, void * buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = read(fd, (char *)buf + done, len - done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		done += r;
+	}
+	return 0;
+}
+
+static int
+exec_write_full(int fd, const void * buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = write(fd, (const char *)buf + done, len - done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		done += r;
+	}
+	return 0;
+}
+
+/* exec_worker_main  -  run commands for the parent until it is done
+ *
+ * Does not return.
+ *
+ * @intf:	ipmi interface, as set up by the parent
+ * @cmds:	commands of the file
+ * @cmd_fd:	indexes of the commands to run
+ * @res_fd:	results of the commands
+ */
+static void
+exec_worker_main(struct ipmi_intf * intf, struct exec_cmd * cmds,
+		 int cmd_fd, int res_fd)
+{
+	const int std_fd[2] = { STDOUT_FILENO, STDERR_FILENO };
+	struct exec_result res;
+	struct exec_cmd * cmd;
+	FILE * tmp[2];
+	char buf[4096];
+	int index, i;
+	size_t left;
+	ssize_t r;
+
+	/* the parent's session is not ours to share, open one of our own */
+	if (intf->opened) {
+		if (intf->fd >= 0)
+			close(intf->fd);
+		intf->fd = -1;
+		intf->opened = 0;
+		intf->session = NULL;
+	}
+	if (intf->open && intf->open(intf) < 0)
+		exit(EXIT_FAILURE);
+
+	tmp[0] = tmpfile();
+	tmp[1] = tmpfile();
+	if (!tmp[0] || !tmp[1]) {
+		lperror(LOG_ERR, "tmpfile");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < 2; i++)
+		dup2(fileno(tmp[i]), std_fd[i]);
+
+	while (exec_read_full(cmd_fd, &index, sizeof(index)) == 0) {
+		cmd = &cmds[index];
+
+		for (i = 0; i < 2; i++) {
+			if (ftruncate(std_fd[i], 0) < 0
+			    || lseek(std_fd[i], 0, SEEK_SET) < 0)
+				exit(EXIT_FAILURE);
+		}
+
+		res.index = index;
+		res.rc = ipmi_cmd_run(intf, cmd->argv[0], cmd->argc - 1,
+				      &(cmd->argv[1]));
+		fflush(stdout);
+		fflush(stderr);
+
+		for (i = 0; i < 2; i++)
+			res.len[i] = lseek(std_fd[i], 0, SEEK_CUR);
+		if (exec_write_full(res_fd, &res, sizeof(res)) < 0)
+			break;
+
+		for (i = 0; i < 2; i++) {
+			lseek(std_fd[i], 0, SEEK_SET);
+			for (left = res.len[i]; left > 0; left -= r) {
+				r = read(std_fd[i], buf, left < sizeof(buf)
+					 ? left : sizeof(buf));
+				if (r <= 0 || exec_write_full(res_fd, buf, r) < 0)
+					exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (intf->opened && intf->close)
+		intf->close(intf);
+	exit(EXIT_SUCCESS);
+}
+
+/* exec_worker_spawn  -  start a worker
+ *
+ * @intf:	ipmi interface
+ * @cmds:	commands of the file
+ * @workers:	all workers, for the worker to close what is not its own
+ * @w:		index of the worker to start
+ *
+ * returns 0 on success, -1 on error
+ */
+static int
+exec_worker_spawn(struct ipmi_intf * intf, struct exec_cmd * cmds,
+		  struct exec_worker * workers, int w)
+{
+	int cmd[2], res[2];
+	int i;
+
+	if (pipe(cmd) < 0) {
+		lperror(LOG_ERR, "pipe");
+		return -1;
+	}
+	if (pipe(res) < 0) {
+		lperror(LOG_ERR, "pipe");
+		close(cmd[0]);
+		close(cmd[1]);
+		return -1;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	workers[w].pid = fork();
+	if (workers[w].pid < 0) {
+		lperror(LOG_ERR, "fork");
+		workers[w].pid = 0;
+		close(cmd[0]);
+		close(cmd[1]);
+		close(res[0]);
+		close(res[1]);
+		return -1;
+	}
+
+	if (workers[w].pid == 0) {
+		/* leave nothing of the parent behind */
+		for (i = 0; i < w; i++) {
+			if (!workers[i].pid)
+				continue;
+			close(workers[i].cmd_fd);
+			close(workers[i].res_fd);
+		}
+		close(cmd[1]);
+		close(res[0]);
+		exec_worker_main(intf, cmds, cmd[0], res[1]);
+	}
+
+	close(cmd[0]);
+	close(res[1]);
+	workers[w].cmd_fd = cmd[1];
+	workers[w].res_fd = res[0];
+	workers[w].busy = -1;
+	return 0;
+}
+
+/* exec_worker_stop  -  close the pipes of a worker and collect it
+ *
+ * A command the worker was running is failed.
+ */
+static void
+exec_worker_stop(struct exec_worker * w, struct exec_cmd * cmds)
+{
+	int status;
+
+	close(w->cmd_fd);
+	close(w->res_fd);
+	while (waitpid(w->pid, &status, 0) < 0 && errno == EINTR)
+		;
+	w->pid = 0;
+
+	if (w->busy >= 0) {
+		lprintf(LOG_ERR, "exec: worker died running '%s'",
+			cmds[w->busy].argv[0]);
+		cmds[w->busy].rc = -1;
+		cmds[w->busy].state = EXEC_CMD_DONE;
+		w->busy = -1;
+	}
+}
+
+/* exec_worker_collect  -  receive the result of a command from a worker
+ *
+ * returns 0 on success, -1 if the worker is gone
+ */
+static int
+exec_worker_collect(struct exec_worker * w, struct exec_cmd * cmds)
+{
+	struct exec_result res;
+	struct exec_cmd * cmd;
+	int i;
+
+	if (exec_read_full(w->res_fd, &res, sizeof(res)) < 0
+	    || res.index != w->busy)
+		return -1;
+
+	cmd = &cmds[res.index];
+	for (i = 0; i < 2; i++) {
+		cmd->len[i] = res.len[i];
+		if (!res.len[i])
+			continue;
+		cmd->out[i] = malloc(res.len[i]);
+		if (!cmd->out[i]) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return -1;
+		}
+		if (exec_read_full(w->res_fd, cmd->out[i], res.len[i]) < 0)
+			return -1;
+	}
+
+	cmd->rc = res.rc;
+	cmd->state = EXEC_CMD_DONE;
+	w->busy = -1;
+	return 0;
+}
+
+/* exec_emit  -  print the output captured for a command */
+static void
+exec_emit(struct exec_cmd * cmd)
+{
+	if (cmd->len[0])
+		fwrite(cmd->out[0], 1, cmd->len[0], stdout);
+	fflush(stdout);
+	if (cmd->len[1])
+		fwrite(cmd->out[1], 1, cmd->len[1], stderr);
+	fflush(stderr);
+
+	free(cmd->out[0]);
+	free(cmd->out[1]);
+	cmd->out[0] = cmd->out[1] = NULL;
+}
+
+/* ipmi_exec_parallel  -  run the commands of a file with several workers
+ *
+ * @intf:	ipmi interface
+ * @cmds:	commands of the file
+ * @ncmds:	number of commands
+ * @jobs:	maximum number of commands run at the same time
+ *
+ * returns 0 if all commands succeeded
+ * returns the last non-zero command result otherwise
+ */
+static int
+ipmi_exec_parallel(struct ipmi_intf * intf, struct exec_cmd * cmds,
+		   int ncmds, int jobs)
+{
+	struct exec_worker * workers;
+	struct exec_worker ** owner;
+	struct pollfd * pfd;
+	void (*sigpipe)(int);
+	int next = 0, emitted = 0;
+	int rc = 0;
+	int i, n;
+
+	workers = calloc(jobs, sizeof(struct exec_worker));
+	owner = calloc(jobs, sizeof(struct exec_worker *));
+	pfd = calloc(jobs, sizeof(struct pollfd));
+	if (!workers || !owner || !pfd) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		free(workers);
+		free(owner);
+		free(pfd);
+		return -1;
+	}
+
+	/* a worker may die between two commands */
+	sigpipe = signal(SIGPIPE, SIG_IGN);
+
+	for (i = 0; i < jobs; i++)
+		exec_worker_spawn(intf, cmds, workers, i);
+
+	lprintf(LOG_INFO, "Running %d commands, %d at a time", ncmds, jobs);
+
+	for (;;) {
+		/* print finished commands in file order */
+		while (emitted < ncmds && cmds[emitted].state == EXEC_CMD_DONE) {
+			exec_emit(&cmds[emitted]);
+			if (cmds[emitted].rc != 0)
+				rc = cmds[emitted].rc;
+			emitted++;
+		}
+		if (emitted == ncmds)
+			break;
+
+		/* a "wait" line is passed once all before it are printed */
+		if (next < ncmds && !cmds[next].argc) {
+			if (emitted < next)
+				goto wait;
+			cmds[next++].state = EXEC_CMD_DONE;
+			continue;
+		}
+
+		/* keep every worker busy while there are commands left */
+		for (i = 0; i < jobs && next < ncmds && cmds[next].argc; i++) {
+			if (!workers[i].pid || workers[i].busy >= 0)
+				continue;
+			if (exec_write_full(workers[i].cmd_fd, &next,
+					    sizeof(next)) < 0) {
+				exec_worker_stop(&workers[i], cmds);
+				continue;
+			}
+			workers[i].busy = next;
+			cmds[next++].state = EXEC_CMD_RUNNING;
+		}
+
+ wait:
+		n = 0;
+		for (i = 0; i < jobs; i++) {
+			if (!workers[i].pid || workers[i].busy < 0)
+				continue;
+			pfd[n].fd = workers[i].res_fd;
+			pfd[n].events = POLLIN;
+			pfd[n].revents = 0;
+			owner[n] = &workers[i];
+			n++;
+		}
+
+		if (!n) {
+			lprintf(LOG_ERR, "exec: no workers left, %d commands "
+				"not run", ncmds - next);
+			rc = -1;
+			break;
+		}
+
+		if (poll(pfd, n, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			lperror(LOG_ERR, "poll");
+			rc = -1;
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (pfd[i].revents
+			    && exec_worker_collect(owner[i], cmds) < 0)
+				exec_worker_stop(owner[i], cmds);
+		}
+	}
+
+	/* end of commands tells the workers to close their sessions */
+	for (i = 0; i < jobs; i++) {
+		if (workers[i].pid)
+			exec_worker_stop(&workers[i], cmds);
+	}
+	for (i = emitted; i < ncmds; i++) {
+		free(cmds[i].out[0]);
+		free(cmds[i].out[1]);
+	}
+
+	signal(SIGPIPE, sigpipe);
+	free(workers);
+	free(owner);
+	free(pfd);
+	return rc;
+}
+
 int ipmi_exec_main(struct ipmi_intf * intf, int argc, char ** argv)
 {
 	FILE * fp;
 	char buf[EXEC_BUF_SIZE];
-	char * ptr, * tok, * ret, * tmp;
-	int __argc, i, r;
+	char * ret;
+	int __argc, r;
 	char * __argv[EXEC_ARG_SIZE];
+	struct exec_cmd * cmds = NULL;
+	int ncmds = 0, size = 0;
+	int jobs = 1;
 	int rc=0;
 
-	if (argc < 1) {
-		lprintf(LOG_ERR, "Usage: exec <filename>");
+	if (argc < 1 || (argc > 1 && (argc != 3 || strcmp(argv[1], "jobs")))) {
+		lprintf(LOG_ERR, "Usage: exec <filename> [jobs <count>]");
+		return -1;
+	}
+
+	if (argc == 3 && (str2int(argv[2], &jobs) != 0
+			  || jobs < 1 || jobs > EXEC_JOBS_MAX)) {
+		lprintf(LOG_ERR, "Invalid number of jobs, 1 to %d allowed",
+			EXEC_JOBS_MAX);
 		return -1;
 	}
 
@@ -423,94 +961,61 @@ int ipmi_exec_main(struct ipmi_intf * intf, int argc, char ** argv)
 		if (!ret)
 			continue;
 
-		/* clip off optional comment tail indicated by # */
-		ptr = strchr(buf, '#');
-		if (ptr)
-			*ptr = '\0';
-		else
-			ptr = buf + strlen(buf);
-
-		/* change "" and '' with spaces in the middle to ~ */
-		ptr = buf;
-		while (*ptr != '\0') {
-			if (*ptr == '"') {
-				ptr++;
-				while (*ptr != '"' && *ptr != '\0') {
-					if (isspace((int)*ptr))
-						*ptr = '~';
-					ptr++;
-				}
-			}
-			if (*ptr == '\'') {
-				ptr++;
-				while (*ptr != '\'' && *ptr != '\0') {
-					if (isspace((int)*ptr))
-						*ptr = '~';
-					ptr++;
-				}
-			}
-			ptr++;
+		__argc = exec_parse_line(buf, __argv);
+		if (__argc < 0) {
+			rc = -1;
+			break;
 		}
-
-		/* clip off trailing and leading whitespace */
-		ptr--;
-		while (isspace((int)*ptr) && ptr >= buf)
-			*ptr-- = '\0';
-		ptr = buf;
-		while (isspace((int)*ptr))
-			ptr++;
-		if (strlen(ptr) == 0)
+		if (__argc == 0)
 			continue;
 
-		/* parse it and make argument list */
-		__argc = 0;
-		for (tok = strtok(ptr, " "); tok; tok = strtok(NULL, " ")) {
-			if (__argc < EXEC_ARG_SIZE) {
-				__argv[__argc++] = strdup(tok);
-				if (!__argv[__argc-1]) {
+		if (jobs > 1) {
+			/* run them all together once the file is read */
+			if (ncmds == size) {
+				struct exec_cmd * tmp;
+
+				size = size ? size * 2 : 64;
+				tmp = realloc(cmds, size * sizeof(struct exec_cmd));
+				if (!tmp) {
 					lprintf(LOG_ERR, "ipmitool: malloc failure");
-					if (fp) {
-						fclose(fp);
-						fp = NULL;
-					}
-					return -1;
-				}
-				tmp = __argv[__argc-1];
-				if (*tmp == '\'') {
-					memmove(tmp, tmp+1, strlen(tmp));
-					while (*tmp != '\'' && *tmp != '\0') {
-						if (*tmp == '~')
-							*tmp = ' ';
-						tmp++;
-					}
-					*tmp = '\0';
-				}
-				if (*tmp == '"') {
-					memmove(tmp, tmp+1, strlen(tmp));
-					while (*tmp != '"' && *tmp != '\0') {
-						if (*tmp == '~')
-							*tmp = ' ';
-						tmp++;
-					}
-					*tmp = '\0';
+					exec_free_args(__argc, __argv);
+					rc = -1;
+					break;
 				}
+				cmds = tmp;
 			}
+			memset(&cmds[ncmds], 0, sizeof(struct exec_cmd));
+			if (exec_is_wait(__argc, __argv)) {
+				exec_free_args(__argc, __argv);
+			} else {
+				cmds[ncmds].argc = __argc;
+				memcpy(cmds[ncmds].argv, __argv,
+				       __argc * sizeof(char *));
+			}
+			ncmds++;
+			continue;
 		}
 
 		/* now run the command, save the result if not successful */
-		r = ipmi_cmd_run(intf, __argv[0], __argc-1, &(__argv[1]));
-		if (r != 0)
-			rc = r;
-
-		/* free argument list */
-		for (i=0; i<__argc; i++) {
-			if (__argv[i]) {
-				free(__argv[i]);
-				__argv[i] = NULL;
-			}
+		if (!exec_is_wait(__argc, __argv)) {
+			r = ipmi_cmd_run(intf, __argv[0], __argc-1, &(__argv[1]));
+			if (r != 0)
+				rc = r;
 		}
+
+		exec_free_args(__argc, __argv);
 	}
 
 	fclose(fp);
+
+	if (rc == 0 && ncmds > 0)
+		rc = ipmi_exec_parallel(intf, cmds, ncmds,
+					jobs < ncmds ? jobs : ncmds);
+
+	while (ncmds > 0) {
+		ncmds--;
+		exec_free_args(cmds[ncmds].argc, cmds[ncmds].argv);
+	}
+	free(cmds);
 	return rc;
 }
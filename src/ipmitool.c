@@ -67,6 +67,7 @@
 #include <ipmitool/ipmi_dcmi.h>
 #include <ipmitool/ipmi_vita.h>
 #include <ipmitool/ipmi_quantaoem.h>
+#include <ipmitool/ipmi_serve.h>
 
 #ifdef HAVE_CONFIG_H
 # include <config.h>
@@ -117,6 +118,7 @@ struct ipmi_cmd ipmitool_cmd_list[] = {
 	{ ipmi_shell_main,   "shell",   "Launch interactive IPMI shell" },
 #endif
 	{ ipmi_exec_main,    "exec",    "Run list of commands from file" },
+	{ ipmi_serve_main,   "serve",   "Answer requests from local clients on a Unix socket" },
 	{ ipmi_set_main,     "set",     "Set runtime variable for shell and exec" },
 	{ ipmi_echo_main,    "echo",    NULL }, /* for echoing lines to stdout in scripts */
 	{ ipmi_hpmfwupg_main,"hpm", "Update HPM components using PICMG HPM.1 file"},
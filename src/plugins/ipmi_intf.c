@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #if defined(HAVE_CONFIG_H)
 # include <config.h>
 #endif
@@ -325,6 +326,18 @@ ipmi_intf_session_set_retry(struct ipmi_intf * intf, int retry)
 	intf->ssn_params.retry = retry;
 }
 
+void
+ipmi_intf_session_set_window(struct ipmi_intf * intf, int window)
+{
+	intf->ssn_params.window = window;
+}
+
+void
+ipmi_intf_session_set_dir(struct ipmi_intf * intf, char * dir)
+{
+	intf->ssn_params.session_dir = dir;
+}
+
 void
 ipmi_intf_session_cleanup(struct ipmi_intf *intf)
 {
@@ -332,10 +345,305 @@ ipmi_intf_session_cleanup(struct ipmi_intf *intf)
 		return;
 	}
 
+	if (intf->session->rq_table) {
+		ipmi_req_clear_entries(intf);
+		free(intf->session->rq_table);
+		intf->session->rq_table = NULL;
+	}
+
 	free(intf->session);
 	intf->session = NULL;
 }
 
+/* __ipmi_req_release  -  return a request table slot to the free pool
+ *
+ * @table:	request table
+ * @e:		entry to release
+ */
+static void
+__ipmi_req_release(struct ipmi_rq_table * table, struct ipmi_rq_entry * e)
+{
+	uint8_t * buf = table->msg[e - table->entry];
+
+	if (e->msg_data && e->msg_data != buf)
+		free(e->msg_data);
+
+	memset(e, 0, sizeof(struct ipmi_rq_entry));
+}
+
+/* ipmi_req_add_entry  -  claim the request table slot for a sequence number
+ *
+ * A request still sitting in the slot is one whose reply will never be
+ * accepted anymore, it gets replaced.
+ *
+ * @intf:	ipmi interface
+ * @req:	request to remember
+ * @req_seq:	6-bit IPMI request sequence number
+ *
+ * returns pointer to the table entry
+ * returns NULL on error
+ */
+struct ipmi_rq_entry *
+ipmi_req_add_entry(struct ipmi_intf * intf, struct ipmi_rq * req, uint8_t req_seq)
+{
+	struct ipmi_session * s = intf->session;
+	struct ipmi_rq_entry * e;
+
+	if (!s)
+		return NULL;
+
+	if (!s->rq_table) {
+		s->rq_table = calloc(1, sizeof(struct ipmi_rq_table));
+		if (!s->rq_table) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			return NULL;
+		}
+	}
+
+	e = &s->rq_table->entry[req_seq % IPMI_RQ_TABLE_SIZE];
+	if (e->busy) {
+		lprintf(LOG_DEBUG+3, "replaced list entry seq=0x%02x cmd=0x%02x",
+			e->rq_seq, e->req.msg.cmd);
+		__ipmi_req_release(s->rq_table, e);
+	}
+
+	memcpy(&e->req, req, sizeof(struct ipmi_rq));
+	e->intf = intf;
+	e->rq_seq = req_seq;
+	e->busy = 1;
+
+	lprintf(LOG_DEBUG+3, "added list entry seq=0x%02x cmd=0x%02x",
+		e->rq_seq, e->req.msg.cmd);
+	return e;
+}
+
+/* ipmi_req_lookup_entry  -  find the outstanding request a reply belongs to
+ *
+ * @intf:	ipmi interface
+ * @seq:	rq_seq of the reply
+ * @cmd:	command of the reply
+ *
+ * returns pointer to the table entry
+ * returns NULL if no such request is outstanding
+ */
+struct ipmi_rq_entry *
+ipmi_req_lookup_entry(struct ipmi_intf * intf, uint8_t seq, uint8_t cmd)
+{
+	struct ipmi_rq_entry * e;
+
+	if (!intf->session || !intf->session->rq_table)
+		return NULL;
+
+	e = &intf->session->rq_table->entry[seq % IPMI_RQ_TABLE_SIZE];
+	if (!e->busy || e->rq_seq != seq || e->req.msg.cmd != cmd)
+		return NULL;
+
+	return e;
+}
+
+void
+ipmi_req_remove_entry(struct ipmi_intf * intf, uint8_t seq, uint8_t cmd)
+{
+	struct ipmi_rq_entry * e;
+
+	e = ipmi_req_lookup_entry(intf, seq, cmd);
+	if (!e)
+		return;
+
+	lprintf(LOG_DEBUG+3, "removed list entry seq=0x%02x cmd=0x%02x",
+		seq, cmd);
+	__ipmi_req_release(intf->session->rq_table, e);
+}
+
+/* ipmi_req_rekey_entry  -  move an outstanding request to another sequence
+ *
+ * Used when a bridged reply carries the sequence number the bridging
+ * controller picked instead of ours.
+ *
+ * @intf:	ipmi interface
+ * @entry:	outstanding request
+ * @seq:	new sequence number
+ */
+void
+ipmi_req_rekey_entry(struct ipmi_intf * intf,
+                     struct ipmi_rq_entry * entry, uint8_t seq)
+{
+	struct ipmi_rq_table * table = intf->session->rq_table;
+	struct ipmi_rq_entry * e;
+
+	e = &table->entry[seq % IPMI_RQ_TABLE_SIZE];
+	if (e == entry)
+		return;
+
+	if (e->busy)
+		__ipmi_req_release(table, e);
+
+	memcpy(e, entry, sizeof(struct ipmi_rq_entry));
+	e->rq_seq = seq;
+	if (entry->msg_data == table->msg[entry - table->entry]) {
+		/* the packet is not needed anymore, a reply came back */
+		e->msg_data = NULL;
+		e->msg_len = 0;
+	}
+	memset(entry, 0, sizeof(struct ipmi_rq_entry));
+}
+
+void
+ipmi_req_clear_entries(struct ipmi_intf * intf)
+{
+	struct ipmi_rq_table * table;
+	int i;
+
+	if (!intf->session || !intf->session->rq_table)
+		return;
+
+	table = intf->session->rq_table;
+	for (i = 0; i < IPMI_RQ_TABLE_SIZE; i++) {
+		if (!table->entry[i].busy)
+			continue;
+		lprintf(LOG_DEBUG+3, "cleared list entry seq=0x%02x cmd=0x%02x",
+			table->entry[i].rq_seq, table->entry[i].req.msg.cmd);
+		__ipmi_req_release(table, &table->entry[i]);
+	}
+}
+
+/* ipmi_req_alloc_msg  -  get the packet buffer for an outstanding request
+ *
+ * @intf:	ipmi interface
+ * @entry:	outstanding request
+ * @len:	packet length
+ *
+ * returns zeroed buffer of at least len bytes, also stored in entry
+ * returns NULL on error
+ */
+uint8_t *
+ipmi_req_alloc_msg(struct ipmi_intf * intf, struct ipmi_rq_entry * entry,
+                   int len)
+{
+	struct ipmi_rq_table * table = intf->session->rq_table;
+	uint8_t * buf = table->msg[entry - table->entry];
+
+	if (entry->msg_data && entry->msg_data != buf)
+		free(entry->msg_data);
+
+	if (len > IPMI_RQ_MSG_SIZE) {
+		buf = malloc(len);
+		if (!buf) {
+			lprintf(LOG_ERR, "ipmitool: malloc failure");
+			entry->msg_data = NULL;
+			return NULL;
+		}
+	}
+
+	memset(buf, 0, len);
+	entry->msg_data = buf;
+	return buf;
+}
+
+/* ipmi_intf_msec  -  current time in milliseconds
+ *
+ * returns milliseconds since the Epoch
+ */
+uint64_t
+ipmi_intf_msec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/* ipmi_intf_rto  -  retransmission timeout for a transmission attempt
+ *
+ * Starts from the estimated timeout, or the session timeout while no
+ * reply has been timed yet, and doubles it with every retry up to the
+ * cap.  The last attempt always waits at least the session timeout so
+ * that slow commands still get their reply.
+ *
+ * @intf:	ipmi interface
+ * @try:	attempt number, 0 for the first transmission
+ *
+ * returns timeout in milliseconds
+ */
+uint32_t
+ipmi_intf_rto(struct ipmi_intf * intf, int try)
+{
+	struct ipmi_session * s = intf->session;
+	uint32_t tmo = intf->ssn_params.timeout * 1000;
+	uint32_t cap = tmo > IPMI_RTO_MAX ? tmo : IPMI_RTO_MAX;
+	uint32_t rto;
+	int i;
+
+	if (!s || !s->rtt.rto)
+		rto = tmo;
+	else
+		rto = s->rtt.rto;
+
+	for (i = 0; i < try && rto < cap; i++)
+		rto <<= 1;
+	if (rto > cap)
+		rto = cap;
+
+	if (try >= intf->ssn_params.retry - 1 && rto < tmo)
+		rto = tmo;
+
+	return rto;
+}
+
+/* ipmi_intf_rtt_update  -  feed a round trip time sample to the estimator
+ *
+ * Smoothed RTT and RTT variance are kept as described in RFC 6298.
+ * Only replies to requests sent once may be timed.
+ *
+ * @intf:	ipmi interface
+ * @rtt:	measured round trip time in milliseconds
+ */
+void
+ipmi_intf_rtt_update(struct ipmi_intf * intf, uint32_t rtt)
+{
+	struct ipmi_session * s = intf->session;
+	uint32_t tmo = intf->ssn_params.timeout * 1000;
+	uint32_t delta;
+
+	if (!s)
+		return;
+
+	if (!s->rtt.rto) {
+		s->rtt.srtt = rtt;
+		s->rtt.rttvar = rtt / 2;
+	} else {
+		delta = (s->rtt.srtt > rtt) ? s->rtt.srtt - rtt : rtt - s->rtt.srtt;
+		s->rtt.rttvar = (3 * s->rtt.rttvar + delta) / 4;
+		s->rtt.srtt = (7 * s->rtt.srtt + rtt) / 8;
+	}
+
+	s->rtt.rto = s->rtt.srtt + 4 * s->rtt.rttvar;
+	if (s->rtt.rto < IPMI_RTO_MIN)
+		s->rtt.rto = IPMI_RTO_MIN;
+	if (tmo && s->rtt.rto > tmo)
+		s->rtt.rto = tmo;
+
+	lprintf(LOG_DEBUG+2, "rtt %u ms: srtt %u rttvar %u rto %u",
+		rtt, s->rtt.srtt, s->rtt.rttvar, s->rtt.rto);
+}
+
+/* ipmi_intf_rtt_timeval  -  how long to wait for the next packet
+ *
+ * @intf:	ipmi interface
+ * @tv:	filled with the current receive timeout of the session
+ */
+void
+ipmi_intf_rtt_timeval(struct ipmi_intf * intf, struct timeval * tv)
+{
+	uint32_t wait = intf->session->rtt.wait;
+
+	if (!wait)
+		wait = intf->session->timeout * 1000;
+
+	tv->tv_sec = wait / 1000;
+	tv->tv_usec = (wait % 1000) * 1000;
+}
+
 void
 ipmi_cleanup(struct ipmi_intf * intf)
 {
@@ -498,6 +806,48 @@ ipmi_intf_socket_connect(struct ipmi_intf * intf)
 }
 #endif
 
+/* ipmi_intf_sendrecv_multi  -  send a batch of independent requests
+ *
+ * Interfaces that can keep more than one request outstanding (see the
+ * -W option) get the whole batch at once, all others are fed the
+ * requests one at a time through sendrecv().
+ *
+ * @intf:	ipmi interface
+ * @req:	array of requests
+ * @rsp:	array of responses, filled in request order
+ * @count:	number of requests
+ *
+ * A request that got no response has rsp[i].data_len set to -1.
+ *
+ * returns number of requests that got a response
+ * returns -1 on error
+ */
+int
+ipmi_intf_sendrecv_multi(struct ipmi_intf *intf, struct ipmi_rq *req,
+                         struct ipmi_rs *rsp, int count)
+{
+	struct ipmi_rs *r;
+	int i, done = 0;
+
+	if (!intf || !req || !rsp || count < 0)
+		return -1;
+
+	if (intf->sendrecv_multi && intf->ssn_params.window > 1)
+		return intf->sendrecv_multi(intf, req, rsp, count);
+
+	for (i = 0; i < count; i++) {
+		r = intf->sendrecv(intf, &req[i]);
+		if (!r) {
+			rsp[i].data_len = -1;
+			continue;
+		}
+		memcpy(&rsp[i], r, sizeof(struct ipmi_rs));
+		done++;
+	}
+
+	return done;
+}
+
 uint16_t
 ipmi_intf_get_max_request_data_size(struct ipmi_intf * intf)
 {
@@ -81,8 +81,6 @@ extern const struct valstr ipmi_privlvl_vals[];
 extern const struct valstr ipmi_authtype_session_vals[];
 extern int verbose;
 
-struct ipmi_rq_entry * ipmi_req_entries;
-static struct ipmi_rq_entry * ipmi_req_entries_tail;
 static uint8_t bridge_possible = 0;
 
 static int ipmi_lan_send_packet(struct ipmi_intf * intf, uint8_t * data, int data_len);
@@ -115,108 +113,6 @@ struct ipmi_intf ipmi_lan_intf = {
 	.target_addr = IPMI_BMC_SLAVE_ADDR,
 };
 
-static struct ipmi_rq_entry *
-ipmi_req_add_entry(struct ipmi_intf * intf, struct ipmi_rq * req, uint8_t req_seq)
-{
-	struct ipmi_rq_entry * e;
-
-	e = malloc(sizeof(struct ipmi_rq_entry));
-	if (!e) {
-		lprintf(LOG_ERR, "ipmitool: malloc failure");
-		return NULL;
-	}
-
-	memset(e, 0, sizeof(struct ipmi_rq_entry));
-	memcpy(&e->req, req, sizeof(struct ipmi_rq));
-
-	e->intf = intf;
-	e->rq_seq = req_seq;
-
-	if (!ipmi_req_entries)
-		ipmi_req_entries = e;
-	else
-		ipmi_req_entries_tail->next = e;
-
-	ipmi_req_entries_tail = e;
-	lprintf(LOG_DEBUG+3, "added list entry seq=0x%02x cmd=0x%02x",
-		e->rq_seq, e->req.msg.cmd);
-	return e;
-}
-
-static struct ipmi_rq_entry *
-ipmi_req_lookup_entry(uint8_t seq, uint8_t cmd)
-{
-	struct ipmi_rq_entry * e = ipmi_req_entries;
-	while (e && (e->rq_seq != seq || e->req.msg.cmd != cmd)) {
-		if (!e->next || e == e->next)
-			return NULL;
-		e = e->next;
-	}
-	return e;
-}
-
-static void
-ipmi_req_remove_entry(uint8_t seq, uint8_t cmd)
-{
-	struct ipmi_rq_entry * p, * e, * saved_next_entry;
-
-	e = p = ipmi_req_entries;
-
-	while (e && (e->rq_seq != seq || e->req.msg.cmd != cmd)) {
-		p = e;
-		e = e->next;
-	}
-	if (e) {
-		lprintf(LOG_DEBUG+3, "removed list entry seq=0x%02x cmd=0x%02x",
-			seq, cmd);
-		saved_next_entry = e->next;
-		p->next = (p->next == e->next) ? NULL : e->next;
-		/* If entry being removed is first in list, fix up list head */
-		if (ipmi_req_entries == e) {
-			if (ipmi_req_entries != p)
-				ipmi_req_entries = p;
-			else
-				ipmi_req_entries = saved_next_entry;
-		}
-		/* If entry being removed is last in list, fix up list tail */
-		if (ipmi_req_entries_tail == e) {
-			if (ipmi_req_entries_tail != p)
-				ipmi_req_entries_tail = p;
-			else
-				ipmi_req_entries_tail = NULL;
-		}
-		if (e->msg_data) {
-			free(e->msg_data);
-			e->msg_data = NULL;
-		}
-		free(e);
-		e = NULL;
-	}
-}
-
-static void
-ipmi_req_clear_entries(void)
-{
-	struct ipmi_rq_entry * p, * e;
-
-	e = ipmi_req_entries;
-	while (e) {
-		lprintf(LOG_DEBUG+3, "cleared list entry seq=0x%02x cmd=0x%02x",
-			e->rq_seq, e->req.msg.cmd);
-		if (e->next) {
-			p = e->next;
-			free(e);
-			e = p;
-		} else {
-			free(e);
-			e = NULL;
-			break;
-		}
-	}
-	ipmi_req_entries = NULL;
-	ipmi_req_entries_tail = NULL;
-}
-
 static int
 get_random(void *data, int len)
 {
@@ -260,8 +156,7 @@ ipmi_lan_recv_packet(struct ipmi_intf * intf)
 	FD_ZERO(&err_set);
 	FD_SET(intf->fd, &err_set);
 
-	tmout.tv_sec = intf->ssn_params.timeout;
-	tmout.tv_usec = 0;
+	ipmi_intf_rtt_timeval(intf, &tmout);
 
 	ret = select(intf->fd + 1, &read_set, NULL, &err_set, &tmout);
 	if (ret < 0 || FD_ISSET(intf->fd, &err_set) || !FD_ISSET(intf->fd, &read_set))
@@ -286,8 +181,7 @@ ipmi_lan_recv_packet(struct ipmi_intf * intf)
 		FD_ZERO(&err_set);
 		FD_SET(intf->fd, &err_set);
 
-		tmout.tv_sec = intf->ssn_params.timeout;
-		tmout.tv_usec = 0;
+		ipmi_intf_rtt_timeval(intf, &tmout);
 
 		ret = select(intf->fd + 1, &read_set, NULL, &err_set, &tmout);
 		if (ret < 0 || FD_ISSET(intf->fd, &err_set) || !FD_ISSET(intf->fd, &read_set))
@@ -590,7 +484,8 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 				rsp->ccode);
 			
 			/* now see if we have outstanding entry in request list */
-			entry = ipmi_req_lookup_entry(rsp->payload.ipmi_response.rq_seq,
+			entry = ipmi_req_lookup_entry(intf,
+						      rsp->payload.ipmi_response.rq_seq,
 						      rsp->payload.ipmi_response.cmd);
 			if (entry) {
 				lprintf(LOG_DEBUG+2, "IPMI Request Match found");
@@ -611,7 +506,7 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 							if (!entry->bridging_level)
 								entry->req.msg.cmd = entry->req.msg.target_cmd;
 							if (!rsp) {
-								ipmi_req_remove_entry(entry->rq_seq, entry->req.msg.cmd);
+								ipmi_req_remove_entry(intf, entry->rq_seq, entry->req.msg.cmd);
 							}
 							continue;
 						} else {
@@ -621,9 +516,10 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 								rsp->data_len - x - 1);
 							rsp->data[x - 8] -= 8;
 							rsp->data_len -= 8;
-							entry->rq_seq = rsp->data[x - 3] >> 2;
 							if (!entry->bridging_level)
 								entry->req.msg.cmd = entry->req.msg.target_cmd;
+							ipmi_req_rekey_entry(intf, entry,
+									     rsp->data[x - 3] >> 2);
 							continue;
 						}
 					} else {
@@ -634,7 +530,8 @@ ipmi_lan_poll_recv(struct ipmi_intf * intf)
 								rsp->data[x-1]);
 					}
 				}
-				ipmi_req_remove_entry(rsp->payload.ipmi_response.rq_seq,
+				ipmi_req_remove_entry(intf,
+						      rsp->payload.ipmi_response.rq_seq,
 						      rsp->payload.ipmi_response.cmd);
 			} else {
 				lprintf(LOG_INFO, "IPMI Request Match NOT FOUND");
@@ -719,17 +616,12 @@ ipmi_lan_build_cmd(struct ipmi_intf * intf, struct ipmi_rq * req, int isRetry)
 	// the seq number we have to re-use the node which has existing
 	// command and sequence number. If we add then we will have redundant node with
 	// same cmd,seq pair
-	entry = ipmi_req_lookup_entry(curr_seq, req->msg.cmd);
+	entry = ipmi_req_lookup_entry(intf, curr_seq, req->msg.cmd);
 	if (entry)
 	{
 		// This indicates that we have already same command and seq in list
-		// No need to add once again and we will re-use the existing node.
-		// Only thing we have to do is clear the msg_data as we create
-		// a new one below in the code for it.
-		if (entry->msg_data) {
-			free(entry->msg_data);
-			entry->msg_data = NULL;
-		}
+		// No need to add once again and we will re-use the existing node
+		// and its packet buffer.
 	}
 	else
 	{
@@ -745,12 +637,11 @@ ipmi_lan_build_cmd(struct ipmi_intf * intf, struct ipmi_rq * req, int isRetry)
 		len += 16;
 	if (intf->transit_addr != intf->my_addr && intf->transit_addr != 0)
 		len += 8;
-	msg = malloc(len);
+	msg = ipmi_req_alloc_msg(intf, entry, len);
 	if (!msg) {
 		lprintf(LOG_ERR, "ipmitool: malloc failure");
 		return NULL;
 	}
-	memset(msg, 0, len);
 
 	/* rmcp header */
 	memcpy(msg, &rmcp, sizeof(rmcp));
@@ -902,6 +793,7 @@ ipmi_lan_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 	struct ipmi_rs * rsp = NULL;
 	int try = 0;
 	int isRetry = 0;
+	uint64_t xmit_time;
 
 	lprintf(LOG_DEBUG, "ipmi_lan_send_cmd:opened=[%d], open=[%d]",
 		intf->opened, intf->open);
@@ -924,10 +816,11 @@ ipmi_lan_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 			return NULL;
 		}
 
+		xmit_time = ipmi_intf_msec();
 		if (ipmi_lan_send_packet(intf, entry->msg_data, entry->msg_len) < 0) {
 			try++;
 			usleep(5000);
-			ipmi_req_remove_entry(entry->rq_seq, entry->req.msg.target_cmd);	
+			ipmi_req_remove_entry(intf, entry->rq_seq, entry->req.msg.target_cmd);	
 			continue;
 		}
 
@@ -940,6 +833,8 @@ ipmi_lan_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 
 		usleep(100);
 
+		/* wait no longer than the retransmission timeout */
+		intf->session->rtt.wait = ipmi_intf_rto(intf, try);
 		rsp = ipmi_lan_poll_recv(intf);
 
 		/* Duplicate Request ccode most likely indicates a response to
@@ -949,8 +844,13 @@ ipmi_lan_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 			rsp = ipmi_lan_poll_recv(intf);
 		}
 		
-		if (rsp)
+		if (rsp) {
+			/* only a reply to a single transmission says anything about RTT */
+			if (!try)
+				ipmi_intf_rtt_update(intf,
+					(uint32_t)(ipmi_intf_msec() - xmit_time));
 			break;
+		}
 
 		usleep(5000);
 		if (++try >= intf->ssn_params.retry) {
@@ -958,6 +858,7 @@ ipmi_lan_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 			break;
 		}
 	}
+	intf->session->rtt.wait = 0;
 
 	// We need to cleanup the existing entries from the list. Because if we 
 	// keep it and then when we send the new command and if the response is for
@@ -981,7 +882,7 @@ ipmi_lan_send_cmd(struct ipmi_intf * intf, struct ipmi_rq * req)
 	//                   <-- [23, 10]
 	//  here if we maintain 23,10 in the list then it will get matched and consider
 	//  23 response as response for 2D.   
-	ipmi_req_clear_entries();
+	ipmi_req_clear_entries(intf);
  
 	return rsp;
 }
@@ -1879,7 +1780,7 @@ ipmi_lan_close(struct ipmi_intf * intf)
 		intf->fd = -1;
 	}
 
-	ipmi_req_clear_entries();
+	ipmi_req_clear_entries(intf);
 	ipmi_intf_session_cleanup(intf);
 	intf->opened = 0;
 	intf->manufacturer_id = IPMI_OEM_UNKNOWN;
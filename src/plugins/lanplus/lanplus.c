@@ -46,6 +46,8 @@
 #include <time.h>
 #include <fcntl.h>
 #include <assert.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 
 #ifdef HAVE_CONFIG_H
 # include <config.h>
@@ -82,16 +84,19 @@ extern const struct valstr ipmi_auth_algorithms[];
 extern const struct valstr ipmi_integrity_algorithms[];
 extern const struct valstr ipmi_encryption_algorithms[];
 
-static struct ipmi_rq_entry * ipmi_req_entries;
-static struct ipmi_rq_entry * ipmi_req_entries_tail;
 
 
 static int ipmi_lanplus_setup(struct ipmi_intf * intf);
+static int lanplus_resume_detach(struct ipmi_intf * intf);
 static int ipmi_lanplus_keepalive(struct ipmi_intf * intf);
 static int ipmi_lan_send_packet(struct ipmi_intf * intf, uint8_t * data, int data_len);
 static struct ipmi_rs * ipmi_lan_recv_packet(struct ipmi_intf * intf);
 static struct ipmi_rs * ipmi_lan_poll_recv(struct ipmi_intf * intf);
 static struct ipmi_rs * ipmi_lanplus_send_ipmi_cmd(struct ipmi_intf * intf, struct ipmi_rq * req);
+static int ipmi_lanplus_send_ipmi_cmd_multi(struct ipmi_intf * intf,
+					    struct ipmi_rq * req,
+					    struct ipmi_rs * rsp,
+					    int count);
 static struct ipmi_rs * ipmi_lanplus_send_payload(struct ipmi_intf * intf,
 												  struct ipmi_v2_payload * payload);
 static void getIpmiPayloadWireRep(
@@ -126,6 +131,15 @@ static void ipmi_lanp_set_max_rp_data_size(struct ipmi_intf * intf, uint16_t siz
 
 static uint8_t bridgePossible = 0;
 
+/*
+ * We have a problem.  we need to know the sequence number when we
+ * build an entry, because we use it in our stored entry.  But we also
+ * need to know the sequence number when we generate our IPMI
+ * representation far below.  The pipelined sender also has to look
+ * ahead at it, so it lives out here.
+ */
+static uint8_t curr_seq = 0;
+
 struct ipmi_intf ipmi_lanplus_intf = {
 	.name = "lanplus",
 	.desc = "IPMI v2.0 RMCP+ LAN Interface",
@@ -133,6 +147,7 @@ struct ipmi_intf ipmi_lanplus_intf = {
 	.open = ipmi_lanplus_open,
 	.close = ipmi_lanplus_close,
 	.sendrecv = ipmi_lanplus_send_ipmi_cmd,
+	.sendrecv_multi = ipmi_lanplus_send_ipmi_cmd_multi,
 	.recv_sol = ipmi_lanplus_recv_sol,
 	.send_sol = ipmi_lanplus_send_sol,
 	.keepalive = ipmi_lanplus_keepalive,
@@ -285,107 +300,6 @@ static const struct valstr plus_payload_types_vals[] = {
 };
 
 
-static struct ipmi_rq_entry *
-ipmi_req_add_entry(struct ipmi_intf * intf, struct ipmi_rq * req, uint8_t req_seq)
-{
-	struct ipmi_rq_entry * e;
-
-	e = malloc(sizeof(struct ipmi_rq_entry));
-	if (!e) {
-		lprintf(LOG_ERR, "ipmitool: malloc failure");
-		return NULL;
-	}
-
-	memset(e, 0, sizeof(struct ipmi_rq_entry));
-	memcpy(&e->req, req, sizeof(struct ipmi_rq));
-
-	e->intf = intf;
-	e->rq_seq = req_seq;
-
-	if (!ipmi_req_entries)
-		ipmi_req_entries = e;
-	else
-		ipmi_req_entries_tail->next = e;
-
-	ipmi_req_entries_tail = e;
-	lprintf(LOG_DEBUG+3, "added list entry seq=0x%02x cmd=0x%02x",
-		e->rq_seq, e->req.msg.cmd);     
-	return e;
-}
-
-
-static struct ipmi_rq_entry *
-ipmi_req_lookup_entry(uint8_t seq, uint8_t cmd)
-{
-	struct ipmi_rq_entry * e = ipmi_req_entries;
-
-	while (e && (e->rq_seq != seq || e->req.msg.cmd != cmd)) {
-		if (e == e->next)
-			return NULL;
-		e = e->next;
-	}
-	return e;
-}
-
-static void
-ipmi_req_remove_entry(uint8_t seq, uint8_t cmd)
-{
-	struct ipmi_rq_entry * p, * e, * saved_next_entry;
-
-	e = p = ipmi_req_entries;
-
-	while (e && (e->rq_seq != seq || e->req.msg.cmd != cmd)) {
-		p = e;
-		e = e->next;
-	}
-	if (e) {
-		lprintf(LOG_DEBUG+3, "removed list entry seq=0x%02x cmd=0x%02x",
-			seq, cmd);
-		saved_next_entry = e->next;
-		p->next = (p->next == e->next) ? NULL : e->next;
-		/* If entry being removed is first in list, fix up list head */
-		if (ipmi_req_entries == e) {
-			if (ipmi_req_entries != p)
-				ipmi_req_entries = p;
-			else
-				ipmi_req_entries = saved_next_entry;
-		}
-		/* If entry being removed is last in list, fix up list tail */
-		if (ipmi_req_entries_tail == e) {
-			if (ipmi_req_entries_tail != p)
-				ipmi_req_entries_tail = p;
-			else
-				ipmi_req_entries_tail = NULL;
-		}
-
-		if (e->msg_data) {
-			free(e->msg_data);
-			e->msg_data = NULL;
-		}
-		free(e);
-		e = NULL;
-	}
-}
-
-static void
-ipmi_req_clear_entries(void)
-{
-	struct ipmi_rq_entry * p, * e;
-
-	e = ipmi_req_entries;
-	while (e) {
-		lprintf(LOG_DEBUG+3, "cleared list entry seq=0x%02x cmd=0x%02x",
-			e->rq_seq, e->req.msg.cmd);
-		p = e->next;
-		free(e);
-		e = p;
-	}
-
-	ipmi_req_entries = NULL;
-	ipmi_req_entries_tail = NULL;
-}
-
-
 int
 ipmi_lan_send_packet(
 					 struct ipmi_intf * intf,
@@ -414,8 +328,7 @@ ipmi_lan_recv_packet(struct ipmi_intf * intf)
 	FD_ZERO(&err_set);
 	FD_SET(intf->fd, &err_set);
 
-	tmout.tv_sec = intf->session->timeout;
-	tmout.tv_usec = 0;
+	ipmi_intf_rtt_timeval(intf, &tmout);
 
 	ret = select(intf->fd + 1, &read_set, NULL, &err_set, &tmout);
 	if (ret < 0 || FD_ISSET(intf->fd, &err_set) || !FD_ISSET(intf->fd, &read_set))
@@ -440,8 +353,7 @@ ipmi_lan_recv_packet(struct ipmi_intf * intf)
 		FD_ZERO(&err_set);
 		FD_SET(intf->fd, &err_set);
 
-		tmout.tv_sec = intf->session->timeout;
-		tmout.tv_usec = 0;
+		ipmi_intf_rtt_timeval(intf, &tmout);
 
 		ret = select(intf->fd + 1, &read_set, NULL, &err_set, &tmout);
 		if (ret < 0 || FD_ISSET(intf->fd, &err_set) || !FD_ISSET(intf->fd, &read_set))
@@ -676,10 +588,16 @@ ipmi_lan_poll_single(struct ipmi_intf * intf)
 		return NULL;
 	}
 
+	/* the session is known to be alive on the BMC */
+	if ((session->v2_data.session_state == LANPLUS_STATE_ACTIVE) &&
+		(rsp->session.authtype == IPMI_SESSION_AUTHTYPE_RMCP_PLUS))
+		session->v2_data.last_rx = time(NULL);
+
 	if ((session->v2_data.session_state == LANPLUS_STATE_ACTIVE)    &&
 			(rsp->session.authtype == IPMI_SESSION_AUTHTYPE_RMCP_PLUS) &&
 			(rsp->session.bEncrypted)) {
 		lanplus_decrypt_payload(session->v2_data.crypt_alg,
+				session->v2_data.k2_decrypt_ctx,
 				session->v2_data.k2,
 				rsp->data + offset,
 				rsp->session.msglen,
@@ -732,7 +650,8 @@ ipmi_lan_poll_single(struct ipmi_intf * intf)
 				rsp->ccode);
 
 			/* Are we expecting this packet? */
-			entry = ipmi_req_lookup_entry(rsp->payload.ipmi_response.rq_seq,
+			entry = ipmi_req_lookup_entry(intf,
+								rsp->payload.ipmi_response.rq_seq,
 								rsp->payload.ipmi_response.cmd);
 
 			if (!entry) {
@@ -775,7 +694,7 @@ ipmi_lan_poll_single(struct ipmi_intf * intf)
 			}
 
 			/* Remove request entry */
-			ipmi_req_remove_entry(rsp->payload.ipmi_response.rq_seq,
+			ipmi_req_remove_entry(intf, rsp->payload.ipmi_response.rq_seq,
 					rsp->payload.ipmi_response.cmd);
 
 			/*
@@ -1567,6 +1486,10 @@ void getSolPayloadWireRep(
  * +----------------------+
  * | Authcode             | var (possibly absent)
  * +----------------------+
+ *
+ * IPMI payloads are built into the buffer preallocated for their
+ * request table entry; other payloads get a malloc'ed buffer which
+ * the caller must free.
  */
 void
 ipmi_lanplus_build_v2x_msg(
@@ -1574,7 +1497,8 @@ ipmi_lanplus_build_v2x_msg(
 							struct ipmi_v2_payload * payload,  /* in  */
 							int                    * msg_len,  /* out */
 							uint8_t         ** msg_data, /* out */
-							uint8_t curr_seq)
+							uint8_t curr_seq,
+							struct ipmi_rq_entry   * entry)    /* in  */
 {
 	uint32_t session_trailer_length = 0;
 	struct ipmi_session * session = intf->session;
@@ -1600,7 +1524,10 @@ ipmi_lanplus_build_v2x_msg(
 		IPMI_MAX_AUTH_CODE_SIZE;       // Authcode
 
 
-	msg = malloc(len);
+	if (entry)
+		msg = ipmi_req_alloc_msg(intf, entry, len);
+	else
+		msg = malloc(len);
 	if (!msg) {
 		lprintf(LOG_ERR, "ipmitool: malloc failure");
 		return;
@@ -1715,7 +1642,8 @@ ipmi_lanplus_build_v2x_msg(
 	default:
 		lprintf(LOG_ERR, "unsupported payload type 0x%x",
 			payload->payload_type);
-		free(msg);
+		if (!entry)
+			free(msg);
 		msg = NULL;
 		assert(0);
 		break;
@@ -1731,6 +1659,7 @@ ipmi_lanplus_build_v2x_msg(
 	{
 		/* Payload len is adjusted as necessary by lanplus_encrypt_payload */
 		lanplus_encrypt_payload(session->v2_data.crypt_alg,        /* input  */
+								session->v2_data.k2_encrypt_ctx,   /* input  */
 								session->v2_data.k2,               /* input  */
 								msg + IPMI_LANPLUS_OFFSET_PAYLOAD, /* input  */
 								payload->payload_length,           /* input  */
@@ -1814,7 +1743,8 @@ ipmi_lanplus_build_v2x_msg(
 
 
 		/* Auth Code */
-		lanplus_HMAC(session->v2_data.integrity_alg,
+		lanplus_HMAC_ctx(session->v2_data.k1_hmac_ctx,
+					 session->v2_data.integrity_alg,
 					 session->v2_data.k1,                /* key        */
 					 session->v2_data.k1_len,            /* key length */
 					 msg + IPMI_LANPLUS_OFFSET_AUTHTYPE, /* hmac input */
@@ -1885,14 +1815,6 @@ ipmi_lanplus_build_v2x_ipmi_cmd(
 	struct ipmi_v2_payload v2_payload;
 	struct ipmi_rq_entry * entry;
 
-	/*
-	 * We have a problem.  we need to know the sequence number here,
-	 * because we use it in our stored entry.  But we also need to
-	 * know the sequence number when we generate our IPMI
-	 * representation far below.
-	 */
-	static uint8_t curr_seq = 0;
-
 	if( isRetry == 0 )
 		curr_seq += 1;
 
@@ -1935,7 +1857,8 @@ ipmi_lanplus_build_v2x_ipmi_cmd(
 					&v2_payload,         // in
 					&(entry->msg_len),   // out
 					&(entry->msg_data),  // out
-					curr_seq); 		// in
+					curr_seq, 		// in
+					entry);			// in
 
 	return entry;
 }
@@ -1993,12 +1916,11 @@ ipmi_lanplus_build_v15_ipmi_cmd(
 
 	len = req->msg.data_len + 21;
 
-	msg = malloc(len);
+	msg = ipmi_req_alloc_msg(intf, entry, len);
 	if (!msg) {
 		lprintf(LOG_ERR, "ipmitool: malloc failure");
 		return NULL;
 	}
-	memset(msg, 0, len);
 
 	/* rmcp header */
 	memcpy(msg, &rmcp, sizeof(rmcp));
@@ -2125,22 +2047,16 @@ ipmi_lanplus_send_payload(
 	struct ipmi_rq_entry * entry = NULL;
 	int                   try = 0;
 	int                   xmit = 1;
-	time_t                ltime;
-	uint32_t	      saved_timeout;
+	int                   sent = 0;
+	uint64_t              ltime = 0;
 
 	if (!intf->opened && intf->open && intf->open(intf) < 0)
 		return NULL;
 
-	/*
-	 * The session timeout is initialized in the above interface open,
-	 * so it will only be valid after the open completes.
-	 */
-	saved_timeout = session->timeout;
 	while (try < intf->ssn_params.retry) {
-		//ltime = time(NULL);
-
 		if (xmit) {
-			ltime = time(NULL);
+			ltime = ipmi_intf_msec();
+			session->rtt.wait = ipmi_intf_rto(intf, try);
 
 			if (payload->payload_type == IPMI_PAYLOAD_TYPE_IPMI)
 			{
@@ -2187,6 +2103,7 @@ ipmi_lanplus_send_payload(
 
 				if (!entry) {
 					lprintf(LOG_ERR, "Aborting send command, unable to build");
+					session->rtt.wait = 0;
 					return NULL;
 				}
 
@@ -2204,7 +2121,8 @@ ipmi_lanplus_send_payload(
 								payload,     /* in  */
 								&msg_length, /* out */
 								&msg_data,   /* out */
-								0);  /* irrelevant for this msg*/
+								0,           /* irrelevant for this msg*/
+								NULL);
 
 			}
 
@@ -2218,7 +2136,8 @@ ipmi_lanplus_send_payload(
 								payload,     /* in  */
 								&msg_length, /* out */
 								&msg_data,   /* out */
-								0);  /* irrelevant for this msg*/
+								0,           /* irrelevant for this msg*/
+								NULL);
 
 			}
 
@@ -2232,7 +2151,8 @@ ipmi_lanplus_send_payload(
 								payload,     /* in  */
 								&msg_length, /* out */
 								&msg_data,   /* out */
-								0);  /* irrelevant for this msg*/
+								0,           /* irrelevant for this msg*/
+								NULL);
 
 			}
 
@@ -2245,7 +2165,8 @@ ipmi_lanplus_send_payload(
 								payload,     /* in  */
 								&msg_length, /* out */
 								&msg_data,   /* out */
-								0);  /* irrelevant for this msg*/
+								0,           /* irrelevant for this msg*/
+								NULL);
 			}
 
 			else
@@ -2258,8 +2179,10 @@ ipmi_lanplus_send_payload(
 
 			if (ipmi_lan_send_packet(intf, msg_data, msg_length) < 0) {
 				lprintf(LOG_ERR, "IPMI LAN send command failed");
+				session->rtt.wait = 0;
 				return NULL;
 			}
+			sent++;
 		}
 
 		/* if we are set to noanswer we do not expect response */
@@ -2337,27 +2260,27 @@ ipmi_lanplus_send_payload(
 				rsp = ipmi_lan_poll_recv(intf);
 			}
 
-			if (rsp)
+			if (rsp) {
+				/* only a reply to a single transmission can be timed */
+				if (sent == 1)
+					ipmi_intf_rtt_update(intf,
+						(uint32_t)(ipmi_intf_msec() - ltime));
 				break;
+			}
 			/* This payload type is retryable for timeouts. */
 			if ((payload->payload_type == IPMI_PAYLOAD_TYPE_IPMI) && entry) {
-				ipmi_req_remove_entry( entry->rq_seq, entry->req.msg.cmd);
+				ipmi_req_remove_entry(intf, entry->rq_seq, entry->req.msg.cmd);
 			}
 		}
 
-		/* only timeout if time exceeds the timeout value */
-		xmit = ((time(NULL) - ltime) >= session->timeout);
+		/* only retransmit once the retransmission timeout has expired */
+		xmit = ((ipmi_intf_msec() - ltime) >= session->rtt.wait);
 
 		usleep(5000);
 
-		if (xmit) {
-			/* increment session timeout by 1 second each retry */
-			session->timeout++;
-		}
-
 		try++;
 	}
-	session->timeout = saved_timeout;
+	session->rtt.wait = 0;
 
 	/* IPMI messages are deleted under ipmi_lan_poll_recv() */
 	switch (payload->payload_type) {
@@ -2659,6 +2582,247 @@ ipmi_lanplus_send_ipmi_cmd(
 }
 
 
+
+/*
+ * State of one request handled by ipmi_lanplus_send_ipmi_cmd_multi
+ */
+struct lanplus_multi_slot {
+	uint8_t rq_seq;
+	uint8_t cmd;
+	int     tries;
+	int     busy;
+	uint64_t sent;	/* ms */
+};
+
+/*
+ * ipmi_lanplus_multi_xmit
+ *
+ * Build and send one request of a pipelined batch.  The rq_seq is moved
+ * past the sequence numbers still owned by outstanding requests, so a
+ * reply can always be matched back to exactly one of them.
+ *
+ * returns 0 on success, -1 on error
+ */
+static int
+ipmi_lanplus_multi_xmit(
+			struct ipmi_intf * intf,
+			struct ipmi_rq * req,
+			struct lanplus_multi_slot * slot,
+			int * seq_map,
+			int idx)
+{
+	struct ipmi_rq_entry * entry;
+	uint8_t next_seq;
+
+	for (;;) {
+		next_seq = (curr_seq + 1 >= 64) ? 0 : curr_seq + 1;
+		if (seq_map[next_seq] < 0)
+			break;
+		curr_seq = next_seq;
+	}
+
+	entry = ipmi_lanplus_build_v2x_ipmi_cmd(intf, req, 0);
+	if (!entry) {
+		lprintf(LOG_ERR, "Aborting send command, unable to build");
+		return -1;
+	}
+
+	slot->rq_seq = entry->rq_seq;
+	slot->cmd    = entry->req.msg.cmd;
+
+	lprintf(LOG_DEBUG, ">> Sending pipelined IPMI command payload");
+	lprintf(LOG_DEBUG, ">>    netfn   : 0x%02x", req->msg.netfn);
+	lprintf(LOG_DEBUG, ">>    command : 0x%02x", req->msg.cmd);
+	lprintf(LOG_DEBUG, ">>    rq_seq  : 0x%02x", slot->rq_seq);
+
+	if (ipmi_lan_send_packet(intf, entry->msg_data, entry->msg_len) < 0) {
+		lprintf(LOG_ERR, "IPMI LAN send command failed");
+		ipmi_req_remove_entry(intf, slot->rq_seq, slot->cmd);
+		return -1;
+	}
+
+	slot->sent = ipmi_intf_msec();
+	slot->busy = 1;
+	seq_map[slot->rq_seq] = idx;
+
+	return 0;
+}
+
+/*
+ * ipmi_lanplus_send_ipmi_cmd_multi
+ *
+ * Send a batch of independent IPMI requests keeping up to
+ * ssn_params.window of them outstanding.  Replies are matched back to
+ * their request through the rq_seq of the outstanding request entries,
+ * so they may arrive in any order.  A request that times out is
+ * retransmitted with a fresh rq_seq until the retry count is used up.
+ *
+ * returns the number of requests that got a response, -1 on error
+ */
+static int
+ipmi_lanplus_send_ipmi_cmd_multi(
+				 struct ipmi_intf * intf,
+				 struct ipmi_rq * req,
+				 struct ipmi_rs * rsp,
+				 int count)
+{
+	struct lanplus_multi_slot * slot;
+	struct ipmi_session * session;
+	struct ipmi_rs * r;
+	int seq_map[64];
+	int window, next = 0, first = 0, inflight = 0, done = 0, answered = 0;
+	int i, idx;
+	uint64_t now, deadline;
+
+	if (!intf->opened && intf->open && intf->open(intf) < 0)
+		return -1;
+
+	session = intf->session;
+
+	/*
+	 * Bridged requests are answered twice and SOL/no-answer modes do not
+	 * reply at all, leave those to the one-at-a-time path.
+	 */
+	if (session->v2_data.session_state != LANPLUS_STATE_ACTIVE ||
+	    intf->noanswer ||
+	    (bridgePossible && intf->target_addr != intf->my_addr))
+	{
+		for (i = 0; i < count; i++) {
+			r = ipmi_lanplus_send_ipmi_cmd(intf, &req[i]);
+			if (!r) {
+				rsp[i].data_len = -1;
+				continue;
+			}
+			memcpy(&rsp[i], r, sizeof(struct ipmi_rs));
+			answered++;
+		}
+		return answered;
+	}
+
+	slot = calloc(count ? count : 1, sizeof(struct lanplus_multi_slot));
+	if (!slot) {
+		lprintf(LOG_ERR, "ipmitool: malloc failure");
+		return -1;
+	}
+
+	for (i = 0; i < 64; i++)
+		seq_map[i] = -1;
+
+	window = intf->ssn_params.window;
+	if (window > IPMI_LANPLUS_MAX_WINDOW)
+		window = IPMI_LANPLUS_MAX_WINDOW;
+
+	while (done < count) {
+		/* top up the window */
+		while (inflight < window && next < count) {
+			if (ipmi_lanplus_multi_xmit(intf, &req[next], &slot[next],
+						    seq_map, next) < 0) {
+				rsp[next].data_len = -1;
+				done++;
+			} else {
+				inflight++;
+			}
+			next++;
+		}
+
+		if (!inflight)
+			break;
+
+		/* wake up in time for the earliest retransmission */
+		deadline = 0;
+		for (i = first; i < next; i++) {
+			uint64_t t;
+
+			if (!slot[i].busy)
+				continue;
+			t = slot[i].sent + ipmi_intf_rto(intf, slot[i].tries);
+			if (!deadline || t < deadline)
+				deadline = t;
+		}
+		now = ipmi_intf_msec();
+		session->rtt.wait = (deadline > now) ? (uint32_t)(deadline - now) : 1;
+
+		r = ipmi_lan_poll_recv(intf);
+
+		if (r && is_sol_packet(r)) {
+			/* SOL data in the middle of our replies, consume it */
+			ack_sol_packet(intf, r);
+			check_sol_packet_for_new_data(r);
+			if (r->data_len && session->sol_data.sol_input_handler)
+				session->sol_data.sol_input_handler(r);
+		} else if (r) {
+			idx = seq_map[r->payload.ipmi_response.rq_seq & 0x3f];
+			if (idx >= 0 && slot[idx].busy &&
+			    slot[idx].cmd == r->payload.ipmi_response.cmd)
+			{
+				seq_map[slot[idx].rq_seq] = -1;
+				slot[idx].busy = 0;
+				inflight--;
+
+				if (r->ccode == 0xcf) {
+					/* duplicate request, this is an older copy */
+					if (ipmi_lanplus_multi_xmit(intf, &req[idx],
+								    &slot[idx],
+								    seq_map, idx) == 0)
+					{
+						inflight++;
+						continue;
+					}
+					rsp[idx].data_len = -1;
+				} else {
+					if (!slot[idx].tries)
+						ipmi_intf_rtt_update(intf, (uint32_t)
+							(ipmi_intf_msec() - slot[idx].sent));
+					memcpy(&rsp[idx], r, sizeof(struct ipmi_rs));
+					answered++;
+				}
+				done++;
+			}
+		}
+
+		/* retransmit what has been outstanding for too long */
+		now = ipmi_intf_msec();
+		while (first < next && !slot[first].busy)
+			first++;
+		for (i = first; i < next; i++) {
+			if (!slot[i].busy ||
+			    now - slot[i].sent < ipmi_intf_rto(intf, slot[i].tries))
+				continue;
+
+			ipmi_req_remove_entry(intf, slot[i].rq_seq, slot[i].cmd);
+			seq_map[slot[i].rq_seq] = -1;
+			slot[i].busy = 0;
+			inflight--;
+
+			if (++slot[i].tries < intf->ssn_params.retry) {
+				lprintf(LOG_DEBUG, "Pipelined request rq_seq 0x%02x "
+					"timed out, retrying", slot[i].rq_seq);
+				if (ipmi_lanplus_multi_xmit(intf, &req[i], &slot[i],
+							    seq_map, i) == 0)
+				{
+					inflight++;
+					continue;
+				}
+			}
+			rsp[i].data_len = -1;
+			done++;
+		}
+	}
+
+	/* nothing left to wait for, drop whatever is still outstanding */
+	for (i = 0; i < next; i++) {
+		if (slot[i].busy) {
+			ipmi_req_remove_entry(intf, slot[i].rq_seq, slot[i].cmd);
+			rsp[i].data_len = -1;
+		}
+	}
+	session->rtt.wait = 0;
+
+	free(slot);
+	return answered;
+}
+
+
 /*
  * ipmi_get_auth_capabilities_cmd
  *
@@ -3302,6 +3466,10 @@ ipmi_lanplus_rakp3(struct ipmi_intf * intf)
 void
 ipmi_lanplus_close(struct ipmi_intf * intf)
 {
+	/* a session saved for later invocations stays open */
+	if (intf->session && lanplus_resume_detach(intf) == 0)
+		intf->abort = 1;
+
 	if (!intf->abort && intf->session)
 		ipmi_close_session_cmd(intf);
 
@@ -3310,7 +3478,9 @@ ipmi_lanplus_close(struct ipmi_intf * intf)
 		intf->fd = -1;
 	}
 
-	ipmi_req_clear_entries();
+	ipmi_req_clear_entries(intf);
+	if (intf->session)
+		lanplus_free_crypt_ctx(intf->session);
 	ipmi_intf_session_cleanup(intf);
 	intf->opened = 0;
 	intf->manufacturer_id = IPMI_OEM_UNKNOWN;
@@ -3422,6 +3592,412 @@ ipmi_find_best_cipher_suite(struct ipmi_intf *intf)
 	return best_suite;
 }
 
+/*
+ * Sessions kept for later invocations (-J dir).  The state of an active
+ * session is stored in a file named after a HMAC of the connection
+ * parameters, keyed with the password, so a file is only picked up by
+ * invocations that would have opened the very same session.  The file is
+ * locked for as long as an invocation uses the session; an invocation
+ * that finds it locked opens a session of its own.
+ *
+ * A session is used without further ado if it answered within the last
+ * LANPLUS_RESUME_TRUST seconds, probed with a Get Device ID if it is
+ * older, and given up once it is LANPLUS_RESUME_EXPIRE seconds old, when
+ * BMCs have usually timed it out.
+ */
+#define LANPLUS_RESUME_MAGIC	"ISES"
+#define LANPLUS_RESUME_VERSION	1
+#define LANPLUS_RESUME_TRUST	10
+#define LANPLUS_RESUME_EXPIRE	60
+
+struct lanplus_resume {
+	char magic[4];
+	uint8_t version;
+	uint8_t cipher_suite_id;
+	uint8_t auth_alg;
+	uint8_t integrity_alg;
+	uint8_t crypt_alg;
+	uint8_t max_priv_level;
+	uint8_t k1_len;
+	uint8_t k2_len;
+	uint32_t bmc_id;
+	uint32_t console_id;
+	uint32_t out_seq;
+	uint32_t manufacturer_id;
+	uint16_t max_request_data_size;
+	uint16_t max_response_data_size;
+	int64_t last_rx;		/* 0 while the session is in use */
+	uint8_t k1[IPMI_MAX_MD_SIZE];
+	uint8_t k2[IPMI_MAX_MD_SIZE];
+};
+
+/*
+ * lanplus_resume_path
+ *
+ * Build the state file name of the session described by the session
+ * parameters of intf.
+ *
+ * returns 0 on success, -1 if the name does not fit
+ */
+static int
+lanplus_resume_path(struct ipmi_intf * intf, char * path, size_t len)
+{
+	struct ipmi_session_params *params = &intf->ssn_params;
+	uint8_t input[512];
+	uint8_t md[IPMI_MAX_MD_SIZE];
+	uint32_t md_len = 0;
+	size_t n = 0, hlen;
+	int i, rc;
+
+	hlen = strlen(params->hostname) + 1;
+	if (hlen + sizeof(params->username) + sizeof(params->kg) + 8
+			> sizeof(input))
+		return -1;
+
+	memcpy(input + n, params->hostname, hlen);
+	n += hlen;
+	memcpy(input + n, params->username, sizeof(params->username));
+	n += sizeof(params->username);
+	memcpy(input + n, params->kg, sizeof(params->kg));
+	n += sizeof(params->kg);
+	input[n++] = params->port >> 8;
+	input[n++] = params->port & 0xff;
+	input[n++] = params->privlvl;
+	input[n++] = params->cipher_suite_id;
+
+	lanplus_HMAC(IPMI_AUTH_RAKP_HMAC_SHA1, params->authcode_set,
+				 IPMI_AUTHCODE_BUFFER_SIZE, input, n, md, &md_len);
+
+	rc = snprintf(path, len, "%s/", params->session_dir);
+	for (i = 0; i < (int)md_len && rc > 0 && (size_t)rc < len; i++)
+		rc += snprintf(path + rc, len - rc, "%02x", md[i]);
+	if (rc < 0 || (size_t)rc + sizeof(".ses") > len)
+		return -1;
+	strcat(path, ".ses");
+
+	return 0;
+}
+
+/*
+ * lanplus_resume_write
+ *
+ * Store the session state.  A zero last_rx marks it as being in use, so
+ * it is not picked up again if this process dies without saving it.
+ */
+static int
+lanplus_resume_write(struct ipmi_intf * intf, time_t last_rx)
+{
+	struct ipmi_session *session = intf->session;
+	struct lanplus_resume rec;
+
+	memset(&rec, 0, sizeof(rec));
+	memcpy(rec.magic, LANPLUS_RESUME_MAGIC, sizeof(rec.magic));
+	rec.version = LANPLUS_RESUME_VERSION;
+	rec.cipher_suite_id = intf->ssn_params.cipher_suite_id;
+	rec.auth_alg = session->v2_data.auth_alg;
+	rec.integrity_alg = session->v2_data.integrity_alg;
+	rec.crypt_alg = session->v2_data.crypt_alg;
+	rec.max_priv_level = session->v2_data.max_priv_level;
+	rec.k1_len = session->v2_data.k1_len;
+	rec.k2_len = session->v2_data.k2_len;
+	rec.bmc_id = session->v2_data.bmc_id;
+	rec.console_id = session->v2_data.console_id;
+	rec.out_seq = session->out_seq;
+	rec.manufacturer_id = intf->manufacturer_id;
+	rec.max_request_data_size = intf->max_request_data_size;
+	rec.max_response_data_size = intf->max_response_data_size;
+	rec.last_rx = last_rx;
+	memcpy(rec.k1, session->v2_data.k1, sizeof(rec.k1));
+	memcpy(rec.k2, session->v2_data.k2, sizeof(rec.k2));
+
+	if (pwrite(session->v2_data.resume_fd, &rec, sizeof(rec), 0)
+			!= sizeof(rec)) {
+		lperror(LOG_DEBUG, "Unable to save session state");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * lanplus_resume_attach
+ *
+ * Take over the session saved by an earlier invocation.  The state file
+ * stays locked until the interface is closed, even if the saved session
+ * cannot be used, so that the new session opened instead is saved.
+ *
+ * returns 0 if the session is active
+ *         -1 if a new session has to be opened
+ */
+static int
+lanplus_resume_attach(struct ipmi_intf * intf)
+{
+	struct ipmi_session *session = intf->session;
+	struct lanplus_resume rec;
+	char path[PATH_MAX];
+	time_t now = time(NULL);
+	int fd, retry;
+
+	if (lanplus_resume_path(intf, path, sizeof(path)) < 0) {
+		lprintf(LOG_DEBUG, "Session state file name too long");
+		return -1;
+	}
+
+	fd = open(path, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		lperror(LOG_WARN, "Unable to open session state %s", path);
+		return -1;
+	}
+	if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+		lprintf(LOG_DEBUG, "Session state %s in use", path);
+		close(fd);
+		return -1;
+	}
+	session->v2_data.resume_fd = fd;
+
+	if (pread(fd, &rec, sizeof(rec), 0) != sizeof(rec)
+		|| memcmp(rec.magic, LANPLUS_RESUME_MAGIC, sizeof(rec.magic))
+		|| rec.version != LANPLUS_RESUME_VERSION
+		|| rec.last_rx <= 0
+		|| now - rec.last_rx >= LANPLUS_RESUME_EXPIRE
+		|| rec.k1_len > sizeof(rec.k1) || rec.k2_len > sizeof(rec.k2))
+		return -1;
+
+	/* mark the state in use before the session is */
+	session->v2_data.auth_alg = rec.auth_alg;
+	session->v2_data.integrity_alg = rec.integrity_alg;
+	session->v2_data.crypt_alg = rec.crypt_alg;
+	session->v2_data.max_priv_level = rec.max_priv_level;
+	session->v2_data.k1_len = rec.k1_len;
+	session->v2_data.k2_len = rec.k2_len;
+	session->v2_data.bmc_id = rec.bmc_id;
+	session->v2_data.console_id = rec.console_id;
+	memcpy(session->v2_data.k1, rec.k1, sizeof(rec.k1));
+	memcpy(session->v2_data.k2, rec.k2, sizeof(rec.k2));
+	session->out_seq = rec.out_seq;
+	session->v2_data.last_rx = rec.last_rx;
+	if (lanplus_resume_write(intf, 0) < 0)
+		goto reset;
+
+	lanplus_init_k1_ctx(session);
+	lanplus_init_k2_ctx(session);
+	session->v2_data.session_state = LANPLUS_STATE_ACTIVE;
+	intf->ssn_params.cipher_suite_id = rec.cipher_suite_id;
+	intf->manufacturer_id = rec.manufacturer_id;
+	intf->max_request_data_size = rec.max_request_data_size;
+	intf->max_response_data_size = rec.max_response_data_size;
+	bridgePossible = 1;
+
+	if (now - rec.last_rx >= LANPLUS_RESUME_TRUST) {
+		/* one quick try, a dead session is replaced anyway */
+		retry = intf->ssn_params.retry;
+		intf->ssn_params.retry = 1;
+		if (ipmi_lanplus_keepalive(intf) < 0) {
+			intf->ssn_params.retry = retry;
+			lprintf(LOG_DEBUG, "Saved session 0x%08x timed out",
+				rec.bmc_id);
+			goto reset;
+		}
+		intf->ssn_params.retry = retry;
+	}
+
+	lprintf(LOG_DEBUG, "Resumed IPMIv2 / RMCP+ session 0x%08x", rec.bmc_id);
+	return 0;
+
+ reset:
+	ipmi_req_clear_entries(intf);
+	lanplus_free_crypt_ctx(session);
+	session->v2_data.session_state = LANPLUS_STATE_PRESESSION;
+	session->v2_data.auth_alg = IPMI_AUTH_RAKP_NONE;
+	session->v2_data.integrity_alg = IPMI_INTEGRITY_NONE;
+	session->v2_data.crypt_alg = IPMI_CRYPT_NONE;
+	session->v2_data.bmc_id = 0;
+	session->v2_data.console_id = 0;
+	session->v2_data.last_rx = 0;
+	session->out_seq = 0;
+	intf->manufacturer_id = IPMI_OEM_UNKNOWN;
+	bridgePossible = 0;
+	return -1;
+}
+
+/*
+ * lanplus_resume_detach
+ *
+ * Save the active session for later invocations and release the state
+ * file.
+ *
+ * returns 0 if the session was saved and must be left open
+ *         -1 if it has to be closed
+ */
+static int
+lanplus_resume_detach(struct ipmi_intf * intf)
+{
+	struct ipmi_session *session = intf->session;
+	int rc = -1;
+
+	if (session->v2_data.resume_fd < 0)
+		return -1;
+
+	if (!intf->abort
+		&& session->v2_data.session_state == LANPLUS_STATE_ACTIVE
+		&& session->v2_data.last_rx > 0
+		&& lanplus_resume_write(intf, session->v2_data.last_rx) == 0)
+		rc = 0;
+
+	close(session->v2_data.resume_fd);
+	session->v2_data.resume_fd = -1;
+	return rc;
+}
+
+/*
+ * What an open learns about a BMC before and after the handshake is kept
+ * per host next to the saved sessions, so that later opens skip the Get
+ * Channel Authentication Capabilities, Get Channel Cipher Suites, HPM.2
+ * capability and Get Device ID round trips.  Entries are used for
+ * LANPLUS_HOST_TTL seconds and dropped whenever an open fails.
+ */
+#define LANPLUS_HOST_MAGIC	"IHST"
+#define LANPLUS_HOST_VERSION	1
+#define LANPLUS_HOST_TTL	3600
+
+struct lanplus_host {
+	char magic[4];
+	uint8_t version;
+	uint8_t privlvl;		/* level auth_cap was read for */
+	uint8_t cipher_suite_id;	/* best suite, reserved if unknown */
+	uint8_t __reserved;
+	uint32_t manufacturer_id;
+	uint16_t max_request_data_size;
+	uint16_t max_response_data_size;
+	int64_t updated;
+	struct get_channel_auth_cap_rsp auth_cap;
+};
+
+/*
+ * lanplus_host_path
+ *
+ * Build the name of the host metadata file of intf.
+ *
+ * returns 0 on success, -1 if the name does not fit
+ */
+static int
+lanplus_host_path(struct ipmi_intf * intf, char * path, size_t len)
+{
+	struct ipmi_session_params *params = &intf->ssn_params;
+	size_t i, start;
+	int n;
+
+	n = snprintf(path, len, "%s/%s-%d.host", params->session_dir,
+				 params->hostname, params->port);
+	if (n < 0 || (size_t)n >= len)
+		return -1;
+
+	/* host names are user input, keep them inside the directory */
+	start = strlen(params->session_dir) + 1;
+	for (i = start; i < start + strlen(params->hostname); i++) {
+		if (path[i] == '/')
+			path[i] = '_';
+	}
+	return 0;
+}
+
+/*
+ * lanplus_host_load
+ *
+ * Read the metadata kept for the host of intf.  host is initialized
+ * either way.
+ *
+ * returns 0 if a fresh entry was found, -1 otherwise
+ */
+static int
+lanplus_host_load(struct ipmi_intf * intf, struct lanplus_host * host)
+{
+	struct lanplus_host rec;
+	char path[PATH_MAX];
+	time_t now = time(NULL);
+	int fd, n;
+
+	memset(host, 0, sizeof(*host));
+	host->cipher_suite_id = IPMI_LANPLUS_CIPHER_SUITE_RESERVED;
+	host->manufacturer_id = IPMI_OEM_UNKNOWN;
+
+	if (lanplus_host_path(intf, path, sizeof(path)) < 0)
+		return -1;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	n = read(fd, &rec, sizeof(rec));
+	close(fd);
+
+	if (n != sizeof(rec)
+		|| memcmp(rec.magic, LANPLUS_HOST_MAGIC, sizeof(rec.magic))
+		|| rec.version != LANPLUS_HOST_VERSION
+		|| rec.privlvl != intf->ssn_params.privlvl
+		|| now < rec.updated
+		|| now - rec.updated >= LANPLUS_HOST_TTL)
+		return -1;
+
+	*host = rec;
+	lprintf(LOG_DEBUG, "Using host information from %s", path);
+	return 0;
+}
+
+/*
+ * lanplus_host_save
+ *
+ * Store the metadata of the host of intf.  The file is written under a
+ * temporary name and renamed into place, so concurrent opens never read
+ * a partial entry.
+ */
+static int
+lanplus_host_save(struct ipmi_intf * intf, struct lanplus_host * host)
+{
+	char path[PATH_MAX];
+	char tmp[PATH_MAX + 16];
+	int fd, rc = 0;
+
+	if (lanplus_host_path(intf, path, sizeof(path)) < 0)
+		return -1;
+
+	memcpy(host->magic, LANPLUS_HOST_MAGIC, sizeof(host->magic));
+	host->version = LANPLUS_HOST_VERSION;
+	host->privlvl = intf->ssn_params.privlvl;
+	host->updated = time(NULL);
+
+	snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		lperror(LOG_DEBUG, "Unable to write %s", tmp);
+		return -1;
+	}
+	if (write(fd, host, sizeof(*host)) != sizeof(*host))
+		rc = -1;
+	if (close(fd) < 0)
+		rc = -1;
+	if (rc == 0 && rename(tmp, path) < 0)
+		rc = -1;
+	if (rc < 0) {
+		lperror(LOG_DEBUG, "Unable to write %s", path);
+		unlink(tmp);
+	}
+	return rc;
+}
+
+/*
+ * lanplus_host_forget
+ *
+ * Drop the metadata of the host of intf, it may be what made the open
+ * fail.
+ */
+static void
+lanplus_host_forget(struct ipmi_intf * intf)
+{
+	char path[PATH_MAX];
+
+	if (lanplus_host_path(intf, path, sizeof(path)) == 0)
+		unlink(path);
+}
+
 /**
  * ipmi_lanplus_open
  */
@@ -3430,7 +4006,9 @@ ipmi_lanplus_open(struct ipmi_intf * intf)
 {
 	int rc;
 	int retry;
+	int cached = 0, save = 0;
 	struct get_channel_auth_cap_rsp auth_cap;
+	struct lanplus_host host;
 	struct ipmi_session_params *params;
 	struct ipmi_session *session;
 
@@ -3477,16 +4055,31 @@ ipmi_lanplus_open(struct ipmi_intf * intf)
 	       sizeof(session->authcode));
 	session->v2_data.auth_alg         = IPMI_AUTH_RAKP_NONE;
 	session->v2_data.crypt_alg        = IPMI_CRYPT_NONE;
+	session->v2_data.resume_fd        = -1;
 	session->sol_data.sequence_number = 1;
 
 	intf->opened = 1;
 	intf->abort = 1;
 
+	/* Take over a session kept by an earlier invocation */
+	if (params->session_dir && lanplus_resume_attach(intf) == 0) {
+		intf->abort = 0;
+		return intf->fd;
+	}
+
+	/* What earlier opens found out about this BMC */
+	if (params->session_dir && !ipmi_oem_active(intf, "i82571spt")) {
+		cached = lanplus_host_load(intf, &host) == 0;
+		save = !cached;
+		if (cached)
+			auth_cap = host.auth_cap;
+	}
+
 	/*
 	 *
 	 * Make sure the BMC supports IPMI v2 / RMCP+
 	 */
-	if (!ipmi_oem_active(intf, "i82571spt") &&
+	if (!ipmi_oem_active(intf, "i82571spt") && !cached &&
 			ipmi_get_auth_capabilities_cmd(intf, &auth_cap)) {
 		lprintf(LOG_INFO, "Error issuing Get Channel "
 			"Authentication Capabilities request");
@@ -3507,10 +4100,14 @@ ipmi_lanplus_open(struct ipmi_intf * intf)
 	if (IPMI_LANPLUS_CIPHER_SUITE_RESERVED ==
 	    intf->ssn_params.cipher_suite_id)
 	{
-		ipmi_intf_session_set_cipher_suite_id(
-			intf,
-			ipmi_find_best_cipher_suite(intf)
-		);
+		if (!cached || IPMI_LANPLUS_CIPHER_SUITE_RESERVED ==
+		    host.cipher_suite_id)
+		{
+			host.cipher_suite_id = ipmi_find_best_cipher_suite(intf);
+			save = params->session_dir != NULL;
+		}
+		ipmi_intf_session_set_cipher_suite_id(intf,
+											  host.cipher_suite_id);
 	}
 
 	/*
@@ -3561,19 +4158,36 @@ ipmi_lanplus_open(struct ipmi_intf * intf)
 		}
 
 		/* automatically detect interface request and response sizes */
-		hpm2_detect_max_payload_size(intf);
+		if (cached) {
+			intf->max_request_data_size = host.max_request_data_size;
+			intf->max_response_data_size = host.max_response_data_size;
+		} else {
+			hpm2_detect_max_payload_size(intf);
+		}
 	}
 
 	bridgePossible = 1;
 
 	if (!ipmi_oem_active(intf, "i82571spt")) {
+		if (cached)
+			intf->manufacturer_id = host.manufacturer_id;
 		intf->manufacturer_id = ipmi_get_oem(intf);
 	}
 
+	if (save) {
+		host.auth_cap = auth_cap;
+		host.max_request_data_size = intf->max_request_data_size;
+		host.max_response_data_size = intf->max_response_data_size;
+		host.manufacturer_id = intf->manufacturer_id;
+		lanplus_host_save(intf, &host);
+	}
+
 	return intf->fd;
 
  fail:
 	lprintf(LOG_ERR, "Error: Unable to establish IPMI v2 / RMCP+ session");
+	if (params->session_dir)
+		lanplus_host_forget(intf);
 	intf->close(intf);
 	return -1;
 }
@@ -3599,6 +4213,7 @@ void test_crypt1(void)
 	printbuf(data, sizeof(data), "original data");
 
 	if (lanplus_encrypt_payload(IPMI_CRYPT_AES_CBC_128,
+								NULL,
 								key,
 								data,
 								sizeof(data),
@@ -3612,6 +4227,7 @@ void test_crypt1(void)
 	
 
 	if (lanplus_decrypt_payload(IPMI_CRYPT_AES_CBC_128,
+								NULL,
 								key,
 								encrypt_buffer,
 								bytes_encrypted,
@@ -3646,7 +4262,8 @@ void test_crypt2(void)
 
 	printbuf((const uint8_t *)data, strlen((const char *)data), "input data");
 
-	lanplus_encrypt_aes_cbc_128(iv,
+	lanplus_encrypt_aes_cbc_128(NULL,
+								iv,
 								key,
 								data,
 								strlen((const char *)data),
@@ -3654,7 +4271,8 @@ void test_crypt2(void)
 								&bytes_encrypted);
 	printbuf((const uint8_t *)encrypt_buffer, bytes_encrypted, "encrypt_buffer");
 
-	lanplus_decrypt_aes_cbc_128(iv,
+	lanplus_decrypt_aes_cbc_128(NULL,
+								iv,
 								key,
 								encrypt_buffer,
 								bytes_encrypted,
@@ -69,6 +69,13 @@
 #define IPMI_LAN_TIMEOUT	1
 #define IPMI_LAN_RETRY		4
 
+/*
+ * Upper bound for the number of outstanding requests (-W).  The rq_seq
+ * field of an IPMI message is only 6 bits wide, so stay well below 64 to
+ * keep late replies from matching a newer request.
+ */
+#define IPMI_LANPLUS_MAX_WINDOW	32
+
 #define IPMI_PRIV_CALLBACK 1
 #define IPMI_PRIV_USER     2
 #define IPMI_PRIV_OPERATOR 3
@@ -664,6 +664,51 @@ lanplus_generate_sik(struct ipmi_session * session, struct ipmi_intf * intf)
 
 
 
+/*
+ * lanplus_init_k1_ctx
+ *
+ * Key the integrity HMAC with K1 once for the whole session.
+ *
+ * param session [in/out].
+ */
+void
+lanplus_init_k1_ctx(struct ipmi_session * session)
+{
+	lanplus_HMAC_ctx_free(session->v2_data.k1_hmac_ctx);
+	session->v2_data.k1_hmac_ctx = NULL;
+	if (session->v2_data.integrity_alg != IPMI_INTEGRITY_NONE)
+		session->v2_data.k1_hmac_ctx =
+			lanplus_HMAC_ctx_new(session->v2_data.integrity_alg,
+								 session->v2_data.k1,
+								 session->v2_data.k1_len);
+}
+
+
+
+/*
+ * lanplus_init_k2_ctx
+ *
+ * Set up the AES key schedules with K2 once for the whole session.
+ *
+ * param session [in/out].
+ */
+void
+lanplus_init_k2_ctx(struct ipmi_session * session)
+{
+	lanplus_aes_cbc_128_ctx_free(session->v2_data.k2_encrypt_ctx);
+	lanplus_aes_cbc_128_ctx_free(session->v2_data.k2_decrypt_ctx);
+	session->v2_data.k2_encrypt_ctx = NULL;
+	session->v2_data.k2_decrypt_ctx = NULL;
+	if (session->v2_data.crypt_alg == IPMI_CRYPT_AES_CBC_128) {
+		session->v2_data.k2_encrypt_ctx =
+			lanplus_aes_cbc_128_ctx_new(session->v2_data.k2, 1);
+		session->v2_data.k2_decrypt_ctx =
+			lanplus_aes_cbc_128_ctx_new(session->v2_data.k2, 0);
+	}
+}
+
+
+
 /*
  * lanplus_generate_k1
  *
@@ -719,6 +764,8 @@ lanplus_generate_k1(struct ipmi_session * session)
 	if (verbose >= 2)
 		printbuf(session->v2_data.k1, session->v2_data.k1_len, "Generated K1");
 
+	lanplus_init_k1_ctx(session);
+
 	return 0;
 }
 
@@ -779,11 +826,33 @@ lanplus_generate_k2(struct ipmi_session * session)
 	if (verbose >= 2)
 		printbuf(session->v2_data.k2, session->v2_data.k2_len, "Generated K2");
 
+	lanplus_init_k2_ctx(session);
+
 	return 0;
 }
 
 
 
+/*
+ * lanplus_free_crypt_ctx
+ *
+ * Release the K1/K2 keyed contexts of a session.
+ *
+ * param session [in/out].
+ */
+void
+lanplus_free_crypt_ctx(struct ipmi_session * session)
+{
+	lanplus_HMAC_ctx_free(session->v2_data.k1_hmac_ctx);
+	lanplus_aes_cbc_128_ctx_free(session->v2_data.k2_encrypt_ctx);
+	lanplus_aes_cbc_128_ctx_free(session->v2_data.k2_decrypt_ctx);
+	session->v2_data.k1_hmac_ctx = NULL;
+	session->v2_data.k2_encrypt_ctx = NULL;
+	session->v2_data.k2_decrypt_ctx = NULL;
+}
+
+
+
 /*
  * lanplus_encrypt_payload
  *
@@ -794,6 +863,7 @@ lanplus_generate_k2(struct ipmi_session * session)
  * 
  * param crypt_alg specifies the encryption algorithm (from table 13-19 of the
  *       IPMI v2 spec)
+ * param ctx is the session's keyed encryption context, or NULL
  * param key is the used as input to the encryption algorithmf
  * param input is the input data to be encrypted
  * param input_length is the length of the input data to be encrypted
@@ -805,7 +875,7 @@ lanplus_generate_k2(struct ipmi_session * session)
  *         1 on failure
  */
 int
-lanplus_encrypt_payload(uint8_t crypt_alg,
+lanplus_encrypt_payload(uint8_t crypt_alg, void * ctx,
 		const uint8_t * key, const uint8_t * input,
 		uint32_t input_length, uint8_t * output,
 		uint16_t * bytes_written)
@@ -865,7 +935,8 @@ lanplus_encrypt_payload(uint8_t crypt_alg,
 
 
 
-	lanplus_encrypt_aes_cbc_128(output,                                     /* IV              */
+	lanplus_encrypt_aes_cbc_128(ctx,                                        /* Context         */
+								output,                                     /* IV              */
 								key,                                        /* K2              */
 								padded_input,                               /* Data to encrypt */
 								input_length + pad_length + 1,              /* Input length    */
@@ -946,7 +1017,8 @@ lanplus_has_valid_auth_code(struct ipmi_rs * rs, struct ipmi_session * session)
 	 */
 	bmc_authcode = rs->data + (rs->data_len - authcode_length);
 
-	lanplus_HMAC(session->v2_data.integrity_alg,
+	lanplus_HMAC_ctx(session->v2_data.k1_hmac_ctx,
+				 session->v2_data.integrity_alg,
 				 session->v2_data.k1,
 				 session->v2_data.k1_len,
 				 rs->data + IPMI_LANPLUS_OFFSET_AUTHTYPE,
@@ -984,7 +1056,7 @@ lanplus_has_valid_auth_code(struct ipmi_rs * rs, struct ipmi_session * session)
  *         1 on failure (we were unable to successfully decrypt the packet)
  */
 int
-lanplus_decrypt_payload(uint8_t crypt_alg, const uint8_t * key,
+lanplus_decrypt_payload(uint8_t crypt_alg, void * ctx, const uint8_t * key,
 		const uint8_t * input, uint32_t input_length,
 		uint8_t * output, uint16_t * payload_size)
 {
@@ -1009,7 +1081,8 @@ lanplus_decrypt_payload(uint8_t crypt_alg, const uint8_t * key,
 	}
 
 
-	lanplus_decrypt_aes_cbc_128(input,                                /* IV              */
+	lanplus_decrypt_aes_cbc_128(ctx,                                  /* Context         */
+								input,                                /* IV              */
 								key,                                  /* Key             */
 								input                        +
 								IPMI_CRYPT_AES_CBC_128_BLOCK_SIZE,    /* Data to decrypt */
@@ -54,13 +54,18 @@ int lanplus_generate_rakp3_authcode(uint8_t                      * buffer,
 int lanplus_generate_sik(struct ipmi_session * session, struct ipmi_intf * intf);
 int lanplus_generate_k1(struct ipmi_session * session);
 int lanplus_generate_k2(struct ipmi_session * session);
+void lanplus_init_k1_ctx(struct ipmi_session * session);
+void lanplus_init_k2_ctx(struct ipmi_session * session);
+void lanplus_free_crypt_ctx(struct ipmi_session * session);
 int lanplus_encrypt_payload(uint8_t         crypt_alg,
+							void          * ctx,
 							const uint8_t * key,
 							const uint8_t * input,
 							uint32_t          input_length,
 							uint8_t       * output,
 							uint16_t      * bytesWritten);
 int lanplus_decrypt_payload(uint8_t         crypt_alg,
+							void          * ctx,
 							const uint8_t * key,
 							const uint8_t * input,
 							uint32_t          input_length,
@@ -38,6 +38,10 @@
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <openssl/err.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+# include <openssl/core_names.h>
+# include <openssl/params.h>
+#endif
 #include <assert.h>
 
 
@@ -110,14 +114,8 @@ lanplus_rand(uint8_t * buffer, uint32_t num_bytes)
  *
  * returns a pointer to md
  */
-uint8_t *
-lanplus_HMAC(uint8_t        mac,
-			 const void          *key,
-			 int                  key_len,
-			 const uint8_t *d,
-			 int                  n,
-			 uint8_t       *md,
-			 uint32_t        *md_len)
+static const EVP_MD *
+lanplus_HMAC_md(uint8_t mac)
 {
 	const EVP_MD *evp_md = NULL;
 
@@ -138,15 +136,208 @@ lanplus_HMAC(uint8_t        mac,
 		assert(0);
 	}
 
+	return evp_md;
+}
+
+uint8_t *
+lanplus_HMAC(uint8_t        mac,
+			 const void          *key,
+			 int                  key_len,
+			 const uint8_t *d,
+			 int                  n,
+			 uint8_t       *md,
+			 uint32_t        *md_len)
+{
+	const EVP_MD *evp_md = lanplus_HMAC_md(mac);
+
 	return HMAC(evp_md, key, key_len, d, n, md, (unsigned int *)md_len);
 }
 
 
+
+/*
+ * lanplus_HMAC_ctx_new
+ *
+ * Create an HMAC context keyed once, to be used with lanplus_HMAC_ctx()
+ * for every packet of a session.
+ *
+ * param mac specifies the algorithm, as for lanplus_HMAC
+ * param key is the key used for HMAC generation
+ * param key_len is the length of key
+ *
+ * returns the context, or NULL if it could not be created.  A NULL
+ *         context makes lanplus_HMAC_ctx() fall back to lanplus_HMAC().
+ */
+void *
+lanplus_HMAC_ctx_new(uint8_t mac, const void *key, int key_len)
+{
+	const EVP_MD *evp_md = lanplus_HMAC_md(mac);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	EVP_MAC *hmac;
+	EVP_MAC_CTX *ctx;
+	OSSL_PARAM params[2];
+
+	hmac = EVP_MAC_fetch(NULL, OSSL_MAC_NAME_HMAC, NULL);
+	if (!hmac)
+		return NULL;
+	ctx = EVP_MAC_CTX_new(hmac);
+	EVP_MAC_free(hmac);
+	if (!ctx)
+		return NULL;
+
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+			(char *)EVP_MD_get0_name(evp_md), 0);
+	params[1] = OSSL_PARAM_construct_end();
+	if (!EVP_MAC_init(ctx, key, key_len, params)) {
+		lprintf(LOG_DEBUG, "ERROR: EVP_MAC_init() failed");
+		EVP_MAC_CTX_free(ctx);
+		return NULL;
+	}
+	return ctx;
+#elif OPENSSL_VERSION_NUMBER >= 0x10100000L
+	HMAC_CTX *ctx;
+
+	ctx = HMAC_CTX_new();
+	if (!ctx)
+		return NULL;
+	if (!HMAC_Init_ex(ctx, key, key_len, evp_md, NULL)) {
+		lprintf(LOG_DEBUG, "ERROR: HMAC_Init_ex() failed");
+		HMAC_CTX_free(ctx);
+		return NULL;
+	}
+	return ctx;
+#else
+	/* no opaque HMAC contexts, every packet uses one-shot HMAC() */
+	(void)evp_md;
+	return NULL;
+#endif
+}
+
+
+
+/*
+ * lanplus_HMAC_ctx_free
+ *
+ * param ctx is a context from lanplus_HMAC_ctx_new, may be NULL
+ */
+void
+lanplus_HMAC_ctx_free(void *ctx)
+{
+	if (!ctx)
+		return;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	EVP_MAC_CTX_free(ctx);
+#elif OPENSSL_VERSION_NUMBER >= 0x10100000L
+	HMAC_CTX_free(ctx);
+#endif
+}
+
+
+
+/*
+ * lanplus_HMAC_ctx
+ *
+ * Compute an HMAC with a context from lanplus_HMAC_ctx_new.  Only the
+ * inner and outer digest state is reset, the key is not processed again.
+ *
+ * param ctx is the keyed context.  If NULL, or if the context fails, the
+ *       HMAC is computed by lanplus_HMAC with mac, key and key_len.
+ * param mac, key, key_len, d, n, md and md_len are as for lanplus_HMAC
+ *
+ * returns a pointer to md
+ */
+uint8_t *
+lanplus_HMAC_ctx(void           *ctx,
+				 uint8_t         mac,
+				 const void     *key,
+				 int             key_len,
+				 const uint8_t  *d,
+				 int             n,
+				 uint8_t        *md,
+				 uint32_t       *md_len)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	size_t len;
+
+	if (ctx &&
+		EVP_MAC_init(ctx, NULL, 0, NULL) &&
+		EVP_MAC_update(ctx, d, n) &&
+		EVP_MAC_final(ctx, md, &len, EVP_MAX_MD_SIZE))
+	{
+		*md_len = len;
+		return md;
+	}
+#elif OPENSSL_VERSION_NUMBER >= 0x10100000L
+	unsigned int len;
+
+	if (ctx &&
+		HMAC_Init_ex(ctx, NULL, 0, NULL, NULL) &&
+		HMAC_Update(ctx, d, n) &&
+		HMAC_Final(ctx, md, &len))
+	{
+		*md_len = len;
+		return md;
+	}
+#endif
+
+	return lanplus_HMAC(mac, key, key_len, d, n, md, md_len);
+}
+
+
+
+/*
+ * lanplus_aes_cbc_128_ctx_new
+ *
+ * Create an AES CBC 128 context with the key schedule set up once, to be
+ * passed to lanplus_encrypt_aes_cbc_128 / lanplus_decrypt_aes_cbc_128.
+ *
+ * param key is the 16 byte key used by the AES algorithm
+ * param encrypt is 1 for an encryption context, 0 for decryption
+ *
+ * returns the context, or NULL on failure
+ */
+void *
+lanplus_aes_cbc_128_ctx_new(const uint8_t * key, int encrypt)
+{
+	EVP_CIPHER_CTX *ctx;
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (!ctx) {
+		lprintf(LOG_DEBUG, "ERROR: EVP_CIPHER_CTX_new() failed");
+		return NULL;
+	}
+	if (!EVP_CipherInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, NULL, encrypt)) {
+		lprintf(LOG_DEBUG, "ERROR: EVP_CipherInit_ex() failed");
+		EVP_CIPHER_CTX_free(ctx);
+		return NULL;
+	}
+	EVP_CIPHER_CTX_set_padding(ctx, 0);
+
+	return ctx;
+}
+
+
+
+/*
+ * lanplus_aes_cbc_128_ctx_free
+ *
+ * param ctx is a context from lanplus_aes_cbc_128_ctx_new, may be NULL
+ */
+void
+lanplus_aes_cbc_128_ctx_free(void *ctx)
+{
+	if (ctx)
+		EVP_CIPHER_CTX_free(ctx);
+}
+
+
 /*
  * lanplus_encrypt_aes_cbc_128
  *
  * Encrypt with the AES CBC 128 algorithm
  *
+ * param context is an encryption context from lanplus_aes_cbc_128_ctx_new,
+ *       or NULL to set up the key schedule for this call only
  * param iv is the 16 byte initialization vector
  * param key is the 16 byte key used by the AES algorithm
  * param input is the data to be encrypted
@@ -157,14 +348,15 @@ lanplus_HMAC(uint8_t        mac,
  *       to 0 on failure, or if 0 bytes were input.
  */
 void
-lanplus_encrypt_aes_cbc_128(const uint8_t * iv,
+lanplus_encrypt_aes_cbc_128(void          * context,
+							const uint8_t * iv,
 							const uint8_t * key,
 							const uint8_t * input,
 							uint32_t          input_length,
 							uint8_t       * output,
 							uint32_t        * bytes_written)
 {
-	EVP_CIPHER_CTX *ctx = NULL;
+	EVP_CIPHER_CTX *ctx = context;
 
 	*bytes_written = 0;
 
@@ -178,17 +370,22 @@ lanplus_encrypt_aes_cbc_128(const uint8_t * iv,
 		printbuf(input, input_length, "encrypting this data");
 	}
 
-	ctx = EVP_CIPHER_CTX_new();
-	if (!ctx) {
-		lprintf(LOG_DEBUG, "ERROR: EVP_CIPHER_CTX_new() failed");
-		return;
-	}
+	if (ctx) {
+		/* keep the key schedule, only load the new IV */
+		EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv);
+	} else {
+		ctx = EVP_CIPHER_CTX_new();
+		if (!ctx) {
+			lprintf(LOG_DEBUG, "ERROR: EVP_CIPHER_CTX_new() failed");
+			return;
+		}
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
-	EVP_CIPHER_CTX_init(ctx);
+		EVP_CIPHER_CTX_init(ctx);
 #else
-	EVP_CIPHER_CTX_reset(ctx);
+		EVP_CIPHER_CTX_reset(ctx);
 #endif
-	EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv);
+		EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv);
+	}
 	EVP_CIPHER_CTX_set_padding(ctx, 0);
 
 	/*
@@ -220,7 +417,8 @@ lanplus_encrypt_aes_cbc_128(const uint8_t * iv,
 		}
 	}
 	/* performs cleanup and free */
-	EVP_CIPHER_CTX_free(ctx);
+	if (ctx != context)
+		EVP_CIPHER_CTX_free(ctx);
 }
 
 
@@ -230,6 +428,8 @@ lanplus_encrypt_aes_cbc_128(const uint8_t * iv,
  *
  * Decrypt with the AES CBC 128 algorithm
  *
+ * param context is a decryption context from lanplus_aes_cbc_128_ctx_new,
+ *       or NULL to set up the key schedule for this call only
  * param iv is the 16 byte initialization vector
  * param key is the 16 byte key used by the AES algorithm
  * param input is the data to be decrypted
@@ -240,14 +440,15 @@ lanplus_encrypt_aes_cbc_128(const uint8_t * iv,
  *       to 0 on failure, or if 0 bytes were input.
  */
 void
-lanplus_decrypt_aes_cbc_128(const uint8_t * iv,
+lanplus_decrypt_aes_cbc_128(void          * context,
+							const uint8_t * iv,
 							const uint8_t * key,
 							const uint8_t * input,
 							uint32_t          input_length,
 							uint8_t       * output,
 							uint32_t        * bytes_written)
 {
-	EVP_CIPHER_CTX *ctx = NULL;
+	EVP_CIPHER_CTX *ctx = context;
 
 	if (verbose >= 5)
 	{
@@ -261,17 +462,22 @@ lanplus_decrypt_aes_cbc_128(const uint8_t * iv,
 	if (input_length == 0)
 		return;
 
-	ctx = EVP_CIPHER_CTX_new();
-	if (!ctx) {
-		lprintf(LOG_DEBUG, "ERROR: EVP_CIPHER_CTX_new() failed");
-		return;
-	}
+	if (ctx) {
+		/* keep the key schedule, only load the new IV */
+		EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, iv);
+	} else {
+		ctx = EVP_CIPHER_CTX_new();
+		if (!ctx) {
+			lprintf(LOG_DEBUG, "ERROR: EVP_CIPHER_CTX_new() failed");
+			return;
+		}
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
-	EVP_CIPHER_CTX_init(ctx);
+		EVP_CIPHER_CTX_init(ctx);
 #else
-	EVP_CIPHER_CTX_reset(ctx);
+		EVP_CIPHER_CTX_reset(ctx);
 #endif
-	EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv);
+		EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv);
+	}
 	EVP_CIPHER_CTX_set_padding(ctx, 0);
 
 	/*
@@ -308,7 +514,8 @@ lanplus_decrypt_aes_cbc_128(const uint8_t * iv,
 		}
 	}
 	/* performs cleanup and free */
-	EVP_CIPHER_CTX_free(ctx);
+	if (ctx != context)
+		EVP_CIPHER_CTX_free(ctx);
 
 	if (verbose >= 5)
 	{
@@ -45,8 +45,26 @@ lanplus_HMAC(uint8_t mac, const void *key, int key_len,
 			 const uint8_t *d, int n, uint8_t *md,
 			 uint32_t *md_len);
 
+void *
+lanplus_HMAC_ctx_new(uint8_t mac, const void *key, int key_len);
+
+void
+lanplus_HMAC_ctx_free(void *ctx);
+
+uint8_t *
+lanplus_HMAC_ctx(void *ctx, uint8_t mac, const void *key, int key_len,
+				 const uint8_t *d, int n, uint8_t *md,
+				 uint32_t *md_len);
+
+void *
+lanplus_aes_cbc_128_ctx_new(const uint8_t * key, int encrypt);
+
+void
+lanplus_aes_cbc_128_ctx_free(void *ctx);
+
 void
-lanplus_encrypt_aes_cbc_128(const uint8_t * iv,
+lanplus_encrypt_aes_cbc_128(void          * context,
+							const uint8_t * iv,
 							const uint8_t * key,
 							const uint8_t * input,
 							uint32_t          input_length,
@@ -55,7 +73,8 @@ lanplus_encrypt_aes_cbc_128(const uint8_t * iv,
 
 
 void
-lanplus_decrypt_aes_cbc_128(const uint8_t * iv,
+lanplus_decrypt_aes_cbc_128(void          * context,
+							const uint8_t * iv,
 							const uint8_t * key,
 							const uint8_t * input,
 							uint32_t          input_length,